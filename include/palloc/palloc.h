@@ -9,22 +9,172 @@
 
 #   define PINIT PCONCAT(pinit, PALLOC_SUFFIX)
 #   define PFINI PCONCAT(pfini, PALLOC_SUFFIX)
+#   define PTRIM PCONCAT(ptrim, PALLOC_SUFFIX)
+#   define PFORK_PREPARE PCONCAT(pfork_prepare, PALLOC_SUFFIX)
+#   define PFORK_PARENT PCONCAT(pfork_parent, PALLOC_SUFFIX)
+#   define PFORK_CHILD PCONCAT(pfork_child, PALLOC_SUFFIX)
 #   define PALLOC PCONCAT(palloc, PALLOC_SUFFIX)
+#   define PCALLOC PCONCAT(pcalloc, PALLOC_SUFFIX)
+#   define PALLOC_SIZED PCONCAT(palloc_sized, PALLOC_SUFFIX)
 #   define PFREE PCONCAT(pfree, PALLOC_SUFFIX)
+#   define PFREE_SIZED PCONCAT(pfree_sized, PALLOC_SUFFIX)
 #   define PREALLOC PCONCAT(prealloc, PALLOC_SUFFIX)
+#   define PALIGNED_ALLOC PCONCAT(paligned_alloc, PALLOC_SUFFIX)
+#   define PMALLOC_USABLE_SIZE PCONCAT(pmalloc_usable_size, PALLOC_SUFFIX)
+#   define PALLOC_BULK PCONCAT(palloc_bulk, PALLOC_SUFFIX)
+#   define PFREE_BULK PCONCAT(pfree_bulk, PALLOC_SUFFIX)
+#   define PARENA_CREATE PCONCAT(parena_create, PALLOC_SUFFIX)
+#   define PARENA_ALLOC PCONCAT(parena_alloc, PALLOC_SUFFIX)
+#   define PARENA_RESET PCONCAT(parena_reset, PALLOC_SUFFIX)
+#   define PARENA_DESTROY PCONCAT(parena_destroy, PALLOC_SUFFIX)
+#   define PSTATS PCONCAT(pstats, PALLOC_SUFFIX)
+#   define PSTATS_DUMP PCONCAT(pstats_dump, PALLOC_SUFFIX)
 #else
 #   define PINIT pinit
 #   define PFINI pfini
+#   define PTRIM ptrim
+#   define PFORK_PREPARE pfork_prepare
+#   define PFORK_PARENT pfork_parent
+#   define PFORK_CHILD pfork_child
 #   define PALLOC palloc
+#   define PCALLOC pcalloc
+#   define PALLOC_SIZED palloc_sized
 #   define PFREE pfree
+#   define PFREE_SIZED pfree_sized
 #   define PREALLOC prealloc
+#   define PALIGNED_ALLOC paligned_alloc
+#   define PMALLOC_USABLE_SIZE pmalloc_usable_size
+#   define PALLOC_BULK palloc_bulk
+#   define PFREE_BULK pfree_bulk
+#   define PARENA_CREATE parena_create
+#   define PARENA_ALLOC parena_alloc
+#   define PARENA_RESET parena_reset
+#   define PARENA_DESTROY parena_destroy
+#   define PSTATS pstats
+#   define PSTATS_DUMP pstats_dump
+#endif
+
+#ifdef __cplusplus
+extern "C" {
 #endif
 
 void PINIT();
 void PFINI();
 
+// Returns chunks whose blocks are all free to the system and reports how many
+// bytes were released. Blocks held in other threads' caches keep their chunk.
+// With PALLOC_LOCKFREE it must not run concurrently with palloc or pfree
+// unless PALLOC_PAGES keeps released chunks mapped.
+size_t PTRIM();
+
+// Handlers for pthread_atfork in processes that fork while other threads may
+// allocate. PFORK_PREPARE takes every lock of the allocator, PFORK_PARENT
+// releases them and PFORK_CHILD sets them up anew in the child.
+void PFORK_PREPARE();
+void PFORK_PARENT();
+void PFORK_CHILD();
+
 void * PALLOC( size_t nbytes );
+
+// Allocates count elements of nbytes each cleared to zero, or returns NULL if
+// count * nbytes overflows. Blocks never handed out of chunks the system
+// just committed and large blocks mapped from it are not cleared again.
+void * PCALLOC( size_t count, size_t nbytes );
+
+// Allocates at least nbytes like PALLOC and stores the usable size of the
+// block, the size of its class or the capacity of a large block, in actual,
+// or 0 if it returns NULL. All of it may be used, so growable buffers can
+// take it as their capacity instead of reallocating early.
+void * PALLOC_SIZED( size_t nbytes, size_t * actual );
 void PFREE( void * p );
+
+// Frees a block without looking up its class, nbytes must be the size the
+// block was allocated with by PALLOC or PALLOC_BULK, or by PALLOC_SIZED or
+// any size up to the actual size it reported. Blocks from PREALLOC
+// and PALIGNED_ALLOC may live in a larger class and must go to PFREE. Builds
+// without NDEBUG check nbytes against the chunk map.
+void PFREE_SIZED( void * p, size_t nbytes );
 void * PREALLOC( void * p, size_t nbytes );
 
+// Allocates nbytes aligned to a power of two alignment, or returns NULL for
+// other alignments. Alignments above the largest class of 256 KB map whole
+// pages with PALLOC_PAGES and keep only those the block needs; without it
+// they come from the C library padded by up to alignment bytes.
+void * PALIGNED_ALLOC( size_t alignment, size_t nbytes );
+size_t PMALLOC_USABLE_SIZE( const void * p );
+
+// Allocates count blocks of nbytes each into out and returns how many were
+// allocated, which is less than count only if a large allocation fails. Runs
+// of blocks are taken from the free list of the class with one atomic
+// operation or lock acquisition.
+size_t PALLOC_BULK( size_t nbytes, size_t count, void ** out );
+
+// Frees count blocks. Consecutive blocks of the same class are returned to
+// its free list with one atomic operation or lock acquisition, NULL entries
+// are skipped.
+void PFREE_BULK( void ** ptrs, size_t count );
+
+// Arenas hand out blocks from palloc chunks with a bump pointer and free all
+// of them at once. An arena has no lock and must only be used by one thread
+// at a time. Its blocks must not be passed to PFREE or PREALLOC, and every
+// arena must be destroyed before PFINI.
+typedef struct parena_t parena_t;
+
+parena_t * PARENA_CREATE();
+
+// Returns nbytes aligned to 16 bytes, or NULL if no memory is left.
+void * PARENA_ALLOC( parena_t * a, size_t nbytes );
+
+// Frees every block of the arena and keeps its chunks for the next blocks.
+void PARENA_RESET( parena_t * a );
+
+// Frees every block and returns the chunks of the arena.
+void PARENA_DESTROY( parena_t * a );
+
+#ifdef PALLOC_STATS
+#   define PSTATS_CLASS_COUNT 52
+
+#   define PSTATS_TEXT 0
+#   define PSTATS_JSON 1
+
+typedef struct pstats_class_t
+{
+    size_t nbytes; // block size of the class
+    size_t allocs;
+    size_t frees;
+    size_t live; // allocs - frees, blocks in thread caches count as free
+    size_t refills; // trips to the shared free list or to fresh chunk memory
+    size_t chunks; // chunks or spans of several chunks for classes above 16 KB
+    size_t reserved; // bytes of the chunks owned by the class
+    size_t requested; // bytes asked for by all allocations so far
+} pstats_class_t;
+
+typedef struct pstats_t
+{
+    pstats_class_t classes[PSTATS_CLASS_COUNT];
+
+    // allocations above the largest class, served by the system allocator
+    size_t large_allocs;
+    size_t large_frees;
+    size_t large_live;
+    size_t large_bytes; // usable bytes of the live large allocations
+
+    size_t allocs;
+    size_t frees;
+} pstats_t;
+
+// Returns a snapshot of the counters. Counters are updated without a common
+// lock and thread caches publish theirs when they refill or spill, so a
+// snapshot taken while other threads allocate is not exact.
+pstats_t PSTATS();
+
+// Writes a snapshot as a text table (PSTATS_TEXT) or a JSON object
+// (PSTATS_JSON) like snprintf and returns the length of the full output.
+size_t PSTATS_DUMP( const pstats_t * s, int format, char * buffer, size_t capacity );
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif // PALLOC_H_
\ No newline at end of file
@@ -0,0 +1,168 @@
+#ifndef PALLOC_PNEW_H_
+#define PALLOC_PNEW_H_
+
+// Replaces the global operator new and delete with palloc. Include it in
+// exactly one C++ source file of the program; PINIT still has to run before
+// the first allocation. Sized deletes go to PFREE_SIZED, aligned ones to
+// PFREE since over-aligned blocks may live in a larger class than their size.
+#ifdef __cplusplus
+#   include "palloc/palloc.h"
+
+#   include <new>
+
+// runs at the start of every operator new, the interposing library built with
+// PALLOC_PRELOAD initializes palloc there
+#   ifndef PALLOC_PNEW_ENTER
+#       define PALLOC_PNEW_ENTER()
+#   endif
+
+void * operator new( std::size_t nbytes )
+{
+    PALLOC_PNEW_ENTER();
+
+    void * p = PALLOC( nbytes );
+
+    if( p == nullptr )
+    {
+        throw std::bad_alloc();
+    }
+
+    return p;
+}
+
+void * operator new[]( std::size_t nbytes )
+{
+    PALLOC_PNEW_ENTER();
+
+    void * p = PALLOC( nbytes );
+
+    if( p == nullptr )
+    {
+        throw std::bad_alloc();
+    }
+
+    return p;
+}
+
+void * operator new( std::size_t nbytes, const std::nothrow_t & ) noexcept
+{
+    PALLOC_PNEW_ENTER();
+
+    return PALLOC( nbytes );
+}
+
+void * operator new[]( std::size_t nbytes, const std::nothrow_t & ) noexcept
+{
+    PALLOC_PNEW_ENTER();
+
+    return PALLOC( nbytes );
+}
+
+void operator delete( void * p ) noexcept
+{
+    PFREE( p );
+}
+
+void operator delete[]( void * p ) noexcept
+{
+    PFREE( p );
+}
+
+void operator delete( void * p, const std::nothrow_t & ) noexcept
+{
+    PFREE( p );
+}
+
+void operator delete[]( void * p, const std::nothrow_t & ) noexcept
+{
+    PFREE( p );
+}
+
+#   if defined(__cpp_sized_deallocation) || (defined(_MSC_VER) && _MSC_VER >= 1900)
+void operator delete( void * p, std::size_t nbytes ) noexcept
+{
+    PFREE_SIZED( p, nbytes );
+}
+
+void operator delete[]( void * p, std::size_t nbytes ) noexcept
+{
+    PFREE_SIZED( p, nbytes );
+}
+#   endif
+
+#   if defined(__cpp_aligned_new)
+void * operator new( std::size_t nbytes, std::align_val_t alignment )
+{
+    PALLOC_PNEW_ENTER();
+
+    void * p = PALIGNED_ALLOC( static_cast<std::size_t>(alignment), nbytes );
+
+    if( p == nullptr )
+    {
+        throw std::bad_alloc();
+    }
+
+    return p;
+}
+
+void * operator new[]( std::size_t nbytes, std::align_val_t alignment )
+{
+    PALLOC_PNEW_ENTER();
+
+    void * p = PALIGNED_ALLOC( static_cast<std::size_t>(alignment), nbytes );
+
+    if( p == nullptr )
+    {
+        throw std::bad_alloc();
+    }
+
+    return p;
+}
+
+void * operator new( std::size_t nbytes, std::align_val_t alignment, const std::nothrow_t & ) noexcept
+{
+    PALLOC_PNEW_ENTER();
+
+    return PALIGNED_ALLOC( static_cast<std::size_t>(alignment), nbytes );
+}
+
+void * operator new[]( std::size_t nbytes, std::align_val_t alignment, const std::nothrow_t & ) noexcept
+{
+    PALLOC_PNEW_ENTER();
+
+    return PALIGNED_ALLOC( static_cast<std::size_t>(alignment), nbytes );
+}
+
+void operator delete( void * p, std::align_val_t ) noexcept
+{
+    PFREE( p );
+}
+
+void operator delete[]( void * p, std::align_val_t ) noexcept
+{
+    PFREE( p );
+}
+
+void operator delete( void * p, std::size_t, std::align_val_t ) noexcept
+{
+    PFREE( p );
+}
+
+void operator delete[]( void * p, std::size_t, std::align_val_t ) noexcept
+{
+    PFREE( p );
+}
+
+void operator delete( void * p, std::align_val_t, const std::nothrow_t & ) noexcept
+{
+    PFREE( p );
+}
+
+void operator delete[]( void * p, std::align_val_t, const std::nothrow_t & ) noexcept
+{
+    PFREE( p );
+}
+#   endif
+#endif
+
+#endif // PALLOC_PNEW_H_
@@ -0,0 +1,322 @@
+#ifndef PALLOC_PPOOL_H_
+#define PALLOC_PPOOL_H_
+
+// PPOOL_DECLARE(NAME, T, A, K) declares a pool of blocks that each hold one
+// T aligned to A bytes, in the translation unit that expands it:
+//
+//   void NAME_init();   before the first NAME_alloc
+//   void NAME_fini();   returns every chunk, all blocks must be dead
+//   T * NAME_alloc();   NULL if no chunk could be allocated
+//   void NAME_free( T * p );
+//   void NAME_flush();  hands the blocks cached by this thread back
+//
+// Blocks carry no header and live in chunks of K blocks taken from palloc.
+// The shared free list is a plain pointer, a tagged lock-free head or a
+// mutex protected head under the same PALLOC_THREAD, PALLOC_LOCKFREE and
+// PALLOC_MUTEX options as palloc itself. With PALLOC_CACHE every thread
+// keeps a list of up to PPOOL_CACHE_LIMIT blocks; a pool has no thread exit
+// hook, so blocks a thread does not flush stay unused until NAME_fini.
+#include "palloc/palloc.h"
+#include "palloc/psync.h"
+
+#define PPOOL_BLOCK_SIZE(NBYTES, A) (((NBYTES) + (A) - 1) / (A) * (A))
+#define PPOOL_CHUNK_ALIGNMENT(A) ((A) < 16 ? 16 : (A))
+
+#define PPOOL_TYPE_BLOCK_T(NAME) NAME##_block_t
+#define PPOOL_TYPE_CHUNK_T(NAME) NAME##_chunk_t
+
+#define PPOOL_NAME_HEAD(NAME) g_##NAME##_head
+#define PPOOL_NAME_CHUNKS(NAME) g_##NAME##_chunks
+#define PPOOL_NAME_MUTEX(NAME) g_##NAME##_mutex
+
+#define PPOOL_DECL_TYPES(NAME, T, A, K) \
+    typedef union PPOOL_TYPE_BLOCK_T(NAME) { \
+        T value; \
+        unsigned char m[PPOOL_BLOCK_SIZE(sizeof( T ), A)]; \
+        union PPOOL_TYPE_BLOCK_T(NAME) * n; \
+    } PPOOL_TYPE_BLOCK_T(NAME); \
+    typedef struct PPOOL_TYPE_CHUNK_T(NAME) { \
+        PPOOL_TYPE_BLOCK_T(NAME) s[K]; \
+        struct PPOOL_TYPE_CHUNK_T(NAME) * next; \
+    } PPOOL_TYPE_CHUNK_T(NAME); \
+    typedef char NAME##_check_alignment[((A) & ((A) - 1)) == 0 && (K) > 1 ? 1 : -1]
+
+// Allocates a chunk, links it into the chunk list with NAME_add_chunk and
+// threads all of its blocks into one run.
+#define PPOOL_DECL_NEW_CHUNK(NAME, A, K) \
+    static PPOOL_TYPE_CHUNK_T(NAME) * NAME##_new_chunk() { \
+        PPOOL_TYPE_CHUNK_T(NAME) * c = (PPOOL_TYPE_CHUNK_T(NAME) *)PALIGNED_ALLOC( PPOOL_CHUNK_ALIGNMENT(A), sizeof( PPOOL_TYPE_CHUNK_T(NAME) ) ); \
+        if( c == NULL ) { \
+            return NULL; \
+        } \
+        for( int i = 0; i != (K) - 1; ++i ) { \
+            c->s[i].n = c->s + i + 1; \
+        } \
+        c->s[(K) - 1].n = NULL; \
+        NAME##_add_chunk( c ); \
+        return c; \
+    }
+
+#define PPOOL_DECL_FREE_CHUNKS(NAME) \
+    static void NAME##_free_chunks( PPOOL_TYPE_CHUNK_T(NAME) * c ) { \
+        while( c != NULL ) { \
+            PPOOL_TYPE_CHUNK_T(NAME) * c_next = c->next; \
+            PFREE( c ); \
+            c = c_next; \
+        } \
+    }
+
+// The shared free list: NAME_push links a run in front of it, NAME_pop takes
+// one block and NAME_pop_batch up to k, both NULL when the list is empty.
+#if defined(PALLOC_THREAD) && defined(PALLOC_LOCKFREE)
+#   define PPOOL_DECL_GLOBAL(NAME, T, A, K) \
+        static PALLOC_STD_ATOMIC64_T PPOOL_NAME_HEAD(NAME) = 0; \
+        static PALLOC_STD_ATOMIC64_T PPOOL_NAME_CHUNKS(NAME) = 0; \
+        static void NAME##_add_chunk( PPOOL_TYPE_CHUNK_T(NAME) * c ) { \
+            unsigned long long h = PALLOC_STD_ATOMIC_LOAD64(&PPOOL_NAME_CHUNKS(NAME)); \
+            do { \
+                c->next = (PPOOL_TYPE_CHUNK_T(NAME) *)(uintptr_t)h; \
+            } while( PALLOC_STD_ATOMIC_COMPARE_EXCHANGE64_WEAK(&PPOOL_NAME_CHUNKS(NAME), &h, (unsigned long long)(uintptr_t)c) == 0 ); \
+        } \
+        PPOOL_DECL_NEW_CHUNK(NAME, A, K) \
+        PPOOL_DECL_FREE_CHUNKS(NAME) \
+        static PALLOC_FORCEINLINE void NAME##_push( PPOOL_TYPE_BLOCK_T(NAME) * b, PPOOL_TYPE_BLOCK_T(NAME) * t ) { \
+            unsigned long long h = PALLOC_STD_ATOMIC_LOAD64(&PPOOL_NAME_HEAD(NAME)); \
+            do { \
+                t->n = PALLOC_TAG_PTR(PPOOL_TYPE_BLOCK_T(NAME), h); \
+            } while( PALLOC_STD_ATOMIC_COMPARE_EXCHANGE64_WEAK(&PPOOL_NAME_HEAD(NAME), &h, PALLOC_TAG_MAKE(h, b)) == 0 ); \
+        } \
+        static PALLOC_FORCEINLINE PPOOL_TYPE_BLOCK_T(NAME) * NAME##_pop() { \
+            unsigned long long h = PALLOC_STD_ATOMIC_LOAD64(&PPOOL_NAME_HEAD(NAME)); \
+            PPOOL_TYPE_BLOCK_T(NAME) * b; \
+            do { \
+                b = PALLOC_TAG_PTR(PPOOL_TYPE_BLOCK_T(NAME), h); \
+                if( b == NULL ) { \
+                    return NULL; \
+                } \
+            } while( PALLOC_STD_ATOMIC_COMPARE_EXCHANGE64_WEAK(&PPOOL_NAME_HEAD(NAME), &h, PALLOC_TAG_MAKE(h, b->n)) == 0 ); \
+            return b; \
+        } \
+        static PALLOC_FORCEINLINE PPOOL_TYPE_BLOCK_T(NAME) * NAME##_pop_batch( unsigned int k, unsigned int * c ) { \
+            unsigned long long h = PALLOC_STD_ATOMIC_LOAD64(&PPOOL_NAME_HEAD(NAME)); \
+            PPOOL_TYPE_BLOCK_T(NAME) * b; \
+            PPOOL_TYPE_BLOCK_T(NAME) * t; \
+            unsigned int i; \
+            for( ;; ) { \
+                b = PALLOC_TAG_PTR(PPOOL_TYPE_BLOCK_T(NAME), h); \
+                if( b == NULL ) { \
+                    return NULL; \
+                } \
+                t = b; \
+                for( i = 1; i != k; ++i ) { \
+                    PPOOL_TYPE_BLOCK_T(NAME) * n = t->n; \
+                    if( n == NULL || PALLOC_STD_ATOMIC_LOAD64(&PPOOL_NAME_HEAD(NAME)) != h ) { \
+                        break; \
+                    } \
+                    t = n; \
+                } \
+                if( PALLOC_STD_ATOMIC_COMPARE_EXCHANGE64_WEAK(&PPOOL_NAME_HEAD(NAME), &h, PALLOC_TAG_MAKE(h, t->n)) == 1 ) { \
+                    break; \
+                } \
+            } \
+            t->n = NULL; \
+            *c = i; \
+            return b; \
+        } \
+        static PALLOC_FORCEINLINE void NAME##_init() { \
+        } \
+        static PALLOC_FORCEINLINE void NAME##_fini() { \
+            unsigned long long h = PALLOC_STD_ATOMIC_LOAD64(&PPOOL_NAME_HEAD(NAME)); \
+            while( PALLOC_STD_ATOMIC_COMPARE_EXCHANGE64_WEAK(&PPOOL_NAME_HEAD(NAME), &h, PALLOC_TAG_MAKE(h, NULL)) == 0 ) { \
+            } \
+            h = PALLOC_STD_ATOMIC_LOAD64(&PPOOL_NAME_CHUNKS(NAME)); \
+            while( PALLOC_STD_ATOMIC_COMPARE_EXCHANGE64_WEAK(&PPOOL_NAME_CHUNKS(NAME), &h, 0) == 0 ) { \
+            } \
+            NAME##_free_chunks( (PPOOL_TYPE_CHUNK_T(NAME) *)(uintptr_t)h ); \
+        }
+#elif defined(PALLOC_THREAD) && defined(PALLOC_MUTEX)
+#   define PPOOL_DECL_GLOBAL(NAME, T, A, K) \
+        static PALLOC_STD_MUTEX_T PPOOL_NAME_MUTEX(NAME); \
+        static PPOOL_TYPE_BLOCK_T(NAME) * PPOOL_NAME_HEAD(NAME) = NULL; \
+        static PPOOL_TYPE_CHUNK_T(NAME) * PPOOL_NAME_CHUNKS(NAME) = NULL; \
+        static void NAME##_add_chunk( PPOOL_TYPE_CHUNK_T(NAME) * c ) { \
+            PALLOC_STD_MUTEX_LOCK(&PPOOL_NAME_MUTEX(NAME)); \
+            c->next = PPOOL_NAME_CHUNKS(NAME); \
+            PPOOL_NAME_CHUNKS(NAME) = c; \
+            PALLOC_STD_MUTEX_UNLOCK(&PPOOL_NAME_MUTEX(NAME)); \
+        } \
+        PPOOL_DECL_NEW_CHUNK(NAME, A, K) \
+        PPOOL_DECL_FREE_CHUNKS(NAME) \
+        static PALLOC_FORCEINLINE void NAME##_push( PPOOL_TYPE_BLOCK_T(NAME) * b, PPOOL_TYPE_BLOCK_T(NAME) * t ) { \
+            PALLOC_STD_MUTEX_LOCK(&PPOOL_NAME_MUTEX(NAME)); \
+            t->n = PPOOL_NAME_HEAD(NAME); \
+            PPOOL_NAME_HEAD(NAME) = b; \
+            PALLOC_STD_MUTEX_UNLOCK(&PPOOL_NAME_MUTEX(NAME)); \
+        } \
+        static PALLOC_FORCEINLINE PPOOL_TYPE_BLOCK_T(NAME) * NAME##_pop() { \
+            PALLOC_STD_MUTEX_LOCK(&PPOOL_NAME_MUTEX(NAME)); \
+            PPOOL_TYPE_BLOCK_T(NAME) * b = PPOOL_NAME_HEAD(NAME); \
+            if( b != NULL ) { \
+                PPOOL_NAME_HEAD(NAME) = b->n; \
+            } \
+            PALLOC_STD_MUTEX_UNLOCK(&PPOOL_NAME_MUTEX(NAME)); \
+            return b; \
+        } \
+        static PALLOC_FORCEINLINE PPOOL_TYPE_BLOCK_T(NAME) * NAME##_pop_batch( unsigned int k, unsigned int * c ) { \
+            PALLOC_STD_MUTEX_LOCK(&PPOOL_NAME_MUTEX(NAME)); \
+            PPOOL_TYPE_BLOCK_T(NAME) * b = PPOOL_NAME_HEAD(NAME); \
+            if( b == NULL ) { \
+                PALLOC_STD_MUTEX_UNLOCK(&PPOOL_NAME_MUTEX(NAME)); \
+                return NULL; \
+            } \
+            PPOOL_TYPE_BLOCK_T(NAME) * t = b; \
+            unsigned int i; \
+            for( i = 1; i != k && t->n != NULL; ++i ) { \
+                t = t->n; \
+            } \
+            PPOOL_NAME_HEAD(NAME) = t->n; \
+            PALLOC_STD_MUTEX_UNLOCK(&PPOOL_NAME_MUTEX(NAME)); \
+            t->n = NULL; \
+            *c = i; \
+            return b; \
+        } \
+        static PALLOC_FORCEINLINE void NAME##_init() { \
+            PALLOC_STD_MUTEX_INIT(&PPOOL_NAME_MUTEX(NAME)); \
+        } \
+        static PALLOC_FORCEINLINE void NAME##_fini() { \
+            NAME##_free_chunks( PPOOL_NAME_CHUNKS(NAME) ); \
+            PPOOL_NAME_HEAD(NAME) = NULL; \
+            PPOOL_NAME_CHUNKS(NAME) = NULL; \
+            PALLOC_STD_MUTEX_FINI(&PPOOL_NAME_MUTEX(NAME)); \
+        }
+#else
+#   define PPOOL_DECL_GLOBAL(NAME, T, A, K) \
+        static PPOOL_TYPE_BLOCK_T(NAME) * PPOOL_NAME_HEAD(NAME) = NULL; \
+        static PPOOL_TYPE_CHUNK_T(NAME) * PPOOL_NAME_CHUNKS(NAME) = NULL; \
+        static void NAME##_add_chunk( PPOOL_TYPE_CHUNK_T(NAME) * c ) { \
+            c->next = PPOOL_NAME_CHUNKS(NAME); \
+            PPOOL_NAME_CHUNKS(NAME) = c; \
+        } \
+        PPOOL_DECL_NEW_CHUNK(NAME, A, K) \
+        PPOOL_DECL_FREE_CHUNKS(NAME) \
+        static PALLOC_FORCEINLINE void NAME##_push( PPOOL_TYPE_BLOCK_T(NAME) * b, PPOOL_TYPE_BLOCK_T(NAME) * t ) { \
+            t->n = PPOOL_NAME_HEAD(NAME); \
+            PPOOL_NAME_HEAD(NAME) = b; \
+        } \
+        static PALLOC_FORCEINLINE PPOOL_TYPE_BLOCK_T(NAME) * NAME##_pop() { \
+            PPOOL_TYPE_BLOCK_T(NAME) * b = PPOOL_NAME_HEAD(NAME); \
+            if( b != NULL ) { \
+                PPOOL_NAME_HEAD(NAME) = b->n; \
+            } \
+            return b; \
+        } \
+        static PALLOC_FORCEINLINE void NAME##_init() { \
+        } \
+        static PALLOC_FORCEINLINE void NAME##_fini() { \
+            NAME##_free_chunks( PPOOL_NAME_CHUNKS(NAME) ); \
+            PPOOL_NAME_HEAD(NAME) = NULL; \
+            PPOOL_NAME_CHUNKS(NAME) = NULL; \
+        }
+#endif
+
+#if defined(PALLOC_THREAD) && defined(PALLOC_CACHE)
+#   ifndef PPOOL_CACHE_BATCH
+#       define PPOOL_CACHE_BATCH 64
+#   endif
+
+#   ifndef PPOOL_CACHE_LIMIT
+#       define PPOOL_CACHE_LIMIT (2 * PPOOL_CACHE_BATCH)
+#   endif
+
+#   define PPOOL_NAME_CACHE_BLOCK(NAME) t_##NAME##_cache_block
+#   define PPOOL_NAME_CACHE_COUNT(NAME) t_##NAME##_cache_count
+
+// A fresh chunk goes whole into the cache of the thread that needed it and
+// the excess is spilled by the next frees.
+#   define PPOOL_DECL_FRONT(NAME, T, K) \
+        static PALLOC_STD_TLS PPOOL_TYPE_BLOCK_T(NAME) * PPOOL_NAME_CACHE_BLOCK(NAME) = NULL; \
+        static PALLOC_STD_TLS unsigned int PPOOL_NAME_CACHE_COUNT(NAME) = 0; \
+        static PALLOC_NOINLINE PPOOL_TYPE_BLOCK_T(NAME) * NAME##_refill() { \
+            PPOOL_TYPE_BLOCK_T(NAME) * b = NAME##_pop_batch( PPOOL_CACHE_BATCH, &PPOOL_NAME_CACHE_COUNT(NAME) ); \
+            if( b == NULL ) { \
+                PPOOL_TYPE_CHUNK_T(NAME) * c = NAME##_new_chunk(); \
+                if( c == NULL ) { \
+                    return NULL; \
+                } \
+                b = c->s + 0; \
+                PPOOL_NAME_CACHE_COUNT(NAME) = (K); \
+            } \
+            return b; \
+        } \
+        static PALLOC_FORCEINLINE T * NAME##_alloc() { \
+            PPOOL_TYPE_BLOCK_T(NAME) * b = PPOOL_NAME_CACHE_BLOCK(NAME); \
+            if( b == NULL ) { \
+                b = NAME##_refill(); \
+                if( b == NULL ) { \
+                    return NULL; \
+                } \
+            } \
+            PPOOL_NAME_CACHE_BLOCK(NAME) = b->n; \
+            --PPOOL_NAME_CACHE_COUNT(NAME); \
+            return &b->value; \
+        } \
+        static PALLOC_FORCEINLINE void NAME##_free( T * p ) { \
+            PPOOL_TYPE_BLOCK_T(NAME) * b = (PPOOL_TYPE_BLOCK_T(NAME) *)(p); \
+            b->n = PPOOL_NAME_CACHE_BLOCK(NAME); \
+            PPOOL_NAME_CACHE_BLOCK(NAME) = b; \
+            if( ++PPOOL_NAME_CACHE_COUNT(NAME) <= PPOOL_CACHE_LIMIT ) { \
+                return; \
+            } \
+            unsigned int spill = PPOOL_NAME_CACHE_COUNT(NAME) - PPOOL_CACHE_BATCH; \
+            PPOOL_TYPE_BLOCK_T(NAME) * t = b; \
+            for( unsigned int i = 1; i != spill; ++i ) { \
+                t = t->n; \
+            } \
+            PPOOL_NAME_CACHE_BLOCK(NAME) = t->n; \
+            PPOOL_NAME_CACHE_COUNT(NAME) = PPOOL_CACHE_BATCH; \
+            NAME##_push( b, t ); \
+        } \
+        static PALLOC_FORCEINLINE void NAME##_flush() { \
+            PPOOL_TYPE_BLOCK_T(NAME) * b = PPOOL_NAME_CACHE_BLOCK(NAME); \
+            if( b == NULL ) { \
+                return; \
+            } \
+            PPOOL_TYPE_BLOCK_T(NAME) * t = b; \
+            while( t->n != NULL ) { \
+                t = t->n; \
+            } \
+            PPOOL_NAME_CACHE_BLOCK(NAME) = NULL; \
+            PPOOL_NAME_CACHE_COUNT(NAME) = 0; \
+            NAME##_push( b, t ); \
+        }
+#else
+#   define PPOOL_DECL_FRONT(NAME, T, K) \
+        static PALLOC_NOINLINE T * NAME##_refill() { \
+            PPOOL_TYPE_CHUNK_T(NAME) * c = NAME##_new_chunk(); \
+            if( c == NULL ) { \
+                return NULL; \
+            } \
+            NAME##_push( c->s + 1, c->s + (K) - 1 ); \
+            return &c->s[0].value; \
+        } \
+        static PALLOC_FORCEINLINE T * NAME##_alloc() { \
+            PPOOL_TYPE_BLOCK_T(NAME) * b = NAME##_pop(); \
+            if( b == NULL ) { \
+                return NAME##_refill(); \
+            } \
+            return &b->value; \
+        } \
+        static PALLOC_FORCEINLINE void NAME##_free( T * p ) { \
+            PPOOL_TYPE_BLOCK_T(NAME) * b = (PPOOL_TYPE_BLOCK_T(NAME) *)(p); \
+            NAME##_push( b, b ); \
+        } \
+        static PALLOC_FORCEINLINE void NAME##_flush() { \
+        }
+#endif
+
+#define PPOOL_DECLARE(NAME, T, A, K) \
+    PPOOL_DECL_TYPES(NAME, T, A, K); \
+    PPOOL_DECL_GLOBAL(NAME, T, A, K) \
+    PPOOL_DECL_FRONT(NAME, T, K)
+
+#endif // PALLOC_PPOOL_H_
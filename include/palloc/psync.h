@@ -0,0 +1,337 @@
+#ifndef PALLOC_PSYNC_H_
+#define PALLOC_PSYNC_H_
+
+// Inlining hints and the atomic, mutex and thread-local shims that palloc and
+// the pools of ppool.h are built on. A PALLOC_CONFIG_THREAD config supplies
+// its own shims instead.
+#include "palloc/pconfig.h"
+
+#include <stdint.h>
+
+#if defined(_MSC_VER)
+#   include <intrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#   define PALLOC_FORCEINLINE __forceinline
+#   define PALLOC_NOINLINE __declspec(noinline)
+#   define PALLOC_ALIGNAS(A) __declspec(align(A))
+#elif defined(__GNUC__) || defined(__clang__)
+#   define PALLOC_FORCEINLINE __inline__ __attribute__((always_inline))
+#   define PALLOC_NOINLINE __attribute__((noinline))
+#   define PALLOC_ALIGNAS(A) __attribute__((aligned(A)))
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#   define PALLOC_FORCEINLINE
+#   define PALLOC_NOINLINE
+#   define PALLOC_ALIGNAS(A) _Alignas(A)
+#else
+#   define PALLOC_FORCEINLINE
+#   define PALLOC_NOINLINE
+#   define PALLOC_ALIGNAS(A)
+#endif
+
+#ifndef PALLOC_CONFIG_THREAD
+#   if defined(PALLOC_THREAD)
+#       if defined(_MSC_VER)
+#           include <Windows.h>
+
+#           define PALLOC_STD_YIELD() SwitchToThread()
+#       else
+#           include <sched.h>
+
+#           define PALLOC_STD_YIELD() sched_yield()
+#       endif
+
+#       if defined(_MSC_VER)
+#           include <intrin.h>
+
+static PALLOC_FORCEINLINE unsigned long long PALLOC_STD_ATOMIC_LOAD64( unsigned long long volatile * p )
+{
+#           if defined(_M_X64)
+    unsigned long long o = *p;
+#           else
+    unsigned long long o = (unsigned long long)_InterlockedCompareExchange64( (__int64 volatile *)p, 0, 0 );
+#           endif
+
+    return o;
+}
+
+static PALLOC_FORCEINLINE void PALLOC_STD_ATOMIC_STORE64( unsigned long long volatile * p, unsigned long long d )
+{
+#           if defined(_M_X64)
+    *p = d;
+#           else
+    _InterlockedExchange64( (__int64 volatile *)p, (__int64)d );
+#           endif
+}
+
+static PALLOC_FORCEINLINE int PALLOC_STD_ATOMIC_COMPARE_EXCHANGE64_WEAK( unsigned long long volatile * p, unsigned long long * e, unsigned long long d )
+{
+    unsigned long long o = (unsigned long long)_InterlockedCompareExchange64( (__int64 volatile *)p, (__int64)d, (__int64)*e );
+
+    if( o == *e )
+    {
+        return 1;
+    }
+
+    *e = o;
+
+    return 0;
+}
+
+#       elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && !defined(__STDC_NO_ATOMICS__)
+#           include <stdatomic.h>
+
+#           define PALLOC_STD_ATOMIC64_T _Atomic unsigned long long
+
+static PALLOC_FORCEINLINE unsigned long long PALLOC_STD_ATOMIC_LOAD64( PALLOC_STD_ATOMIC64_T * p )
+{
+    unsigned long long o = atomic_load_explicit( p, memory_order_acquire );
+
+    return o;
+}
+
+static PALLOC_FORCEINLINE void PALLOC_STD_ATOMIC_STORE64( PALLOC_STD_ATOMIC64_T * p, unsigned long long d )
+{
+    atomic_store_explicit( p, d, memory_order_release );
+}
+
+static PALLOC_FORCEINLINE int PALLOC_STD_ATOMIC_COMPARE_EXCHANGE64_WEAK( PALLOC_STD_ATOMIC64_T * p, unsigned long long * e, unsigned long long d )
+{
+    if( atomic_compare_exchange_weak_explicit( p, e, d, memory_order_acq_rel, memory_order_acquire ) )
+    {
+        return 1;
+    }
+
+    return 0;
+}
+
+#       elif defined(__GNUC__) || defined(__clang__)
+
+static PALLOC_FORCEINLINE unsigned long long PALLOC_STD_ATOMIC_LOAD64( unsigned long long volatile * p )
+{
+    unsigned long long o = __atomic_load_n( p, __ATOMIC_ACQUIRE );
+
+    return o;
+}
+
+static PALLOC_FORCEINLINE void PALLOC_STD_ATOMIC_STORE64( unsigned long long volatile * p, unsigned long long d )
+{
+    __atomic_store_n( p, d, __ATOMIC_RELEASE );
+}
+
+static PALLOC_FORCEINLINE int PALLOC_STD_ATOMIC_COMPARE_EXCHANGE64_WEAK( unsigned long long volatile * p, unsigned long long * e, unsigned long long d )
+{
+    if( __atomic_compare_exchange_n( p, e, d, 1, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE ) )
+    {
+        return 1;
+    }
+
+    return 0;
+}
+
+#       endif
+#   endif
+
+#   if defined(PALLOC_THREAD) && defined(PALLOC_MUTEX)
+#       if defined(_MSC_VER)
+#           include <Windows.h>
+
+typedef CRITICAL_SECTION PALLOC_STD_MUTEX_T;
+
+static PALLOC_FORCEINLINE void PALLOC_STD_MUTEX_INIT( PALLOC_STD_MUTEX_T * l )
+{
+    InitializeCriticalSection( l );
+}
+
+static PALLOC_FORCEINLINE void PALLOC_STD_MUTEX_FINI( PALLOC_STD_MUTEX_T * l )
+{
+    DeleteCriticalSection( l );
+}
+
+static PALLOC_FORCEINLINE void PALLOC_STD_MUTEX_LOCK( PALLOC_STD_MUTEX_T * l )
+{
+    EnterCriticalSection( l );
+}
+
+static PALLOC_FORCEINLINE void PALLOC_STD_MUTEX_UNLOCK( PALLOC_STD_MUTEX_T * l )
+{
+    LeaveCriticalSection( l );
+}
+
+#       else
+#           include <pthread.h>
+
+typedef pthread_mutex_t PALLOC_STD_MUTEX_T;
+
+static PALLOC_FORCEINLINE void PALLOC_STD_MUTEX_INIT( PALLOC_STD_MUTEX_T * l )
+{
+    pthread_mutex_init( l, NULL );
+}
+
+static PALLOC_FORCEINLINE void PALLOC_STD_MUTEX_FINI( PALLOC_STD_MUTEX_T * l )
+{
+    pthread_mutex_destroy( l );
+}
+
+static PALLOC_FORCEINLINE void PALLOC_STD_MUTEX_LOCK( PALLOC_STD_MUTEX_T * l )
+{
+    pthread_mutex_lock( l );
+}
+
+static PALLOC_FORCEINLINE void PALLOC_STD_MUTEX_UNLOCK( PALLOC_STD_MUTEX_T * l )
+{
+    pthread_mutex_unlock( l );
+}
+
+#       endif
+#   endif
+
+#   if defined(PALLOC_THREAD) && (defined(PALLOC_CACHE) || defined(PALLOC_NUMA))
+#       if defined(_MSC_VER)
+#           include <Windows.h>
+
+#           define PALLOC_STD_TLS __declspec(thread)
+#           define PALLOC_STD_THREAD_KEY_CALLBACK NTAPI
+
+typedef DWORD PALLOC_STD_THREAD_KEY_T;
+
+static PALLOC_FORCEINLINE void PALLOC_STD_THREAD_KEY_INIT( PALLOC_STD_THREAD_KEY_T * k, void (PALLOC_STD_THREAD_KEY_CALLBACK * f)(void *) )
+{
+    *k = FlsAlloc( f );
+}
+
+static PALLOC_FORCEINLINE void PALLOC_STD_THREAD_KEY_FINI( PALLOC_STD_THREAD_KEY_T * k )
+{
+    FlsFree( *k );
+}
+
+static PALLOC_FORCEINLINE void PALLOC_STD_THREAD_KEY_SET( PALLOC_STD_THREAD_KEY_T * k, void * v )
+{
+    FlsSetValue( *k, v );
+}
+
+#       else
+#           include <pthread.h>
+
+#           if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#               define PALLOC_STD_TLS _Thread_local
+#           else
+#               define PALLOC_STD_TLS __thread
+#           endif
+
+#           define PALLOC_STD_THREAD_KEY_CALLBACK
+
+typedef pthread_key_t PALLOC_STD_THREAD_KEY_T;
+
+static PALLOC_FORCEINLINE void PALLOC_STD_THREAD_KEY_INIT( PALLOC_STD_THREAD_KEY_T * k, void (PALLOC_STD_THREAD_KEY_CALLBACK * f)(void *) )
+{
+    pthread_key_create( k, f );
+}
+
+static PALLOC_FORCEINLINE void PALLOC_STD_THREAD_KEY_FINI( PALLOC_STD_THREAD_KEY_T * k )
+{
+    pthread_key_delete( *k );
+}
+
+static PALLOC_FORCEINLINE void PALLOC_STD_THREAD_KEY_SET( PALLOC_STD_THREAD_KEY_T * k, void * v )
+{
+    pthread_setspecific( *k, v );
+}
+
+#       endif
+#   endif
+
+// statistics counters only need atomic increments, in every threading mode
+#   if defined(PALLOC_THREAD) && defined(PALLOC_STATS)
+#       if defined(_MSC_VER)
+#           include <intrin.h>
+
+#           define PALLOC_STD_COUNTER_T __int64 volatile
+
+static PALLOC_FORCEINLINE void PALLOC_STD_COUNTER_ADD( PALLOC_STD_COUNTER_T * p, unsigned long long v )
+{
+    _InterlockedExchangeAdd64( p, (__int64)v );
+}
+
+static PALLOC_FORCEINLINE unsigned long long PALLOC_STD_COUNTER_LOAD( PALLOC_STD_COUNTER_T * p )
+{
+    unsigned long long o = (unsigned long long)_InterlockedCompareExchange64( p, 0, 0 );
+
+    return o;
+}
+
+#       elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && !defined(__STDC_NO_ATOMICS__)
+#           include <stdatomic.h>
+
+#           define PALLOC_STD_COUNTER_T _Atomic unsigned long long
+
+static PALLOC_FORCEINLINE void PALLOC_STD_COUNTER_ADD( PALLOC_STD_COUNTER_T * p, unsigned long long v )
+{
+    atomic_fetch_add_explicit( p, v, memory_order_relaxed );
+}
+
+static PALLOC_FORCEINLINE unsigned long long PALLOC_STD_COUNTER_LOAD( PALLOC_STD_COUNTER_T * p )
+{
+    unsigned long long o = atomic_load_explicit( p, memory_order_relaxed );
+
+    return o;
+}
+
+#       elif defined(__GNUC__) || defined(__clang__)
+
+#           define PALLOC_STD_COUNTER_T unsigned long long
+
+static PALLOC_FORCEINLINE void PALLOC_STD_COUNTER_ADD( PALLOC_STD_COUNTER_T * p, unsigned long long v )
+{
+    __atomic_fetch_add( p, v, __ATOMIC_RELAXED );
+}
+
+static PALLOC_FORCEINLINE unsigned long long PALLOC_STD_COUNTER_LOAD( PALLOC_STD_COUNTER_T * p )
+{
+    unsigned long long o = __atomic_load_n( p, __ATOMIC_RELAXED );
+
+    return o;
+}
+
+#       endif
+#   endif
+#endif
+
+#if defined(PALLOC_THREAD)
+#   if !defined(PALLOC_LOCKFREE) && !defined(PALLOC_MUTEX)
+#       error "PALLOC_THREAD requires PALLOC_LOCKFREE or PALLOC_MUTEX"
+#   elif defined(PALLOC_LOCKFREE) && defined(PALLOC_MUTEX)
+#       error "PALLOC_LOCKFREE and PALLOC_MUTEX are mutually exclusive"
+#   endif
+#endif
+
+#if defined(PALLOC_CACHE) && !defined(PALLOC_THREAD)
+#   error "PALLOC_CACHE requires PALLOC_THREAD"
+#endif
+
+#if defined(PALLOC_THREAD)
+#   ifndef PALLOC_STD_ATOMIC64_T
+#       define PALLOC_STD_ATOMIC64_T unsigned long long volatile
+#   endif
+#endif
+
+#if defined(PALLOC_THREAD) && defined(PALLOC_LOCKFREE)
+// Lock-free heads are a block pointer packed with an ABA counter in one
+// 64-bit word: the low 48 bits hold the pointer on 64-bit targets (user
+// space addresses on x86-64 and AArch64), the low 32 bits on 32-bit ones.
+// Every successful push or pop bumps the counter, so a head that compares
+// equal means the list was not touched in between.
+#   if UINTPTR_MAX > 0xffffffffu
+#       define PALLOC_TAG_SHIFT 48
+#   else
+#       define PALLOC_TAG_SHIFT 32
+#   endif
+
+#   define PALLOC_TAG_MASK ((1ULL << PALLOC_TAG_SHIFT) - 1)
+
+#   define PALLOC_TAG_PTR(T, H) ((T *)(uintptr_t)((H) & PALLOC_TAG_MASK))
+#   define PALLOC_TAG_MAKE(H, P) (((((H) >> PALLOC_TAG_SHIFT) + 1) << PALLOC_TAG_SHIFT) | (unsigned long long)(uintptr_t)(P))
+#endif
+
+#endif // PALLOC_PSYNC_H_
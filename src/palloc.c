@@ -1,601 +1,3379 @@
+#if (defined(PALLOC_PAGES) || defined(PALLOC_NUMA_LIBNUMA)) && defined(__linux__) && !defined(_GNU_SOURCE)
+#   define _GNU_SOURCE
+#elif defined(PALLOC_PAGES) && !defined(_MSC_VER) && !defined(_DEFAULT_SOURCE)
+#   define _DEFAULT_SOURCE
+#endif
+
 #include "palloc/palloc.h"
 #include "palloc/pconfig.h"
 
+#include <stdint.h>
+
 #ifndef PALLOC_CONFIG_MEMORY
 #   include <stdlib.h>
 #   include <string.h>
 
-#   define PALLOC_STD_MALLOC(S) malloc(S)
-#   define PALLOC_STD_FREE(P) free(P)
-#   define PALLOC_STD_REALLOC(P, S) realloc(P, S)
+// The interposing library built with PALLOC_PRELOAD is the malloc of the
+// process, its own memory comes from the entry points of the C library's
+// allocator that it replaces.
+#   if defined(PALLOC_PRELOAD)
+void * __libc_malloc( size_t nbytes );
+void __libc_free( void * p );
+void * __libc_realloc( void * p, size_t nbytes );
+void * __libc_calloc( size_t count, size_t nbytes );
+void * __libc_memalign( size_t alignment, size_t nbytes );
+
+#       define PALLOC_STD_MALLOC(S) __libc_malloc(S)
+#       define PALLOC_STD_FREE(P) __libc_free(P)
+#       define PALLOC_STD_REALLOC(P, S) __libc_realloc(P, S)
+#       define PALLOC_STD_CALLOC(C, S) __libc_calloc(C, S)
+#   else
+#       define PALLOC_STD_MALLOC(S) malloc(S)
+#       define PALLOC_STD_FREE(P) free(P)
+#       define PALLOC_STD_REALLOC(P, S) realloc(P, S)
+#       define PALLOC_STD_CALLOC(C, S) calloc(C, S)
+#   endif
+
 #   define PALLOC_STD_MEMCPY(D, S, N) memcpy(D, S, N)
-#endif
+#   define PALLOC_STD_MEMMOVE(D, S, N) memmove(D, S, N)
+#   define PALLOC_STD_MEMSET(D, V, N) memset(D, V, N)
 
-#ifndef PALLOC_CONFIG_THREAD
-#   if defined(PALLOC_THREAD) && defined(PALLOC_LOCKFREE)
+#   if defined(PALLOC_STATS)
+#       include <stdio.h>
+
+#       define PALLOC_STD_VSNPRINTF(B, C, F, A) vsnprintf(B, C, F, A)
+#   endif
+
+#   if defined(_MSC_VER)
+#       include <malloc.h>
+
+#       define PALLOC_STD_ALIGNED_MALLOC(A, S) _aligned_malloc(S, A)
+#       define PALLOC_STD_ALIGNED_FREE(P) _aligned_free(P)
+#   elif defined(PALLOC_PRELOAD)
+#       define PALLOC_STD_ALIGNED_MALLOC(A, S) __libc_memalign(A, S)
+#       define PALLOC_STD_ALIGNED_FREE(P) __libc_free(P)
+#   else
+#       define PALLOC_STD_ALIGNED_MALLOC(A, S) aligned_alloc(A, S)
+#       define PALLOC_STD_ALIGNED_FREE(P) free(P)
+#   endif
+
+// Page primitives for the PALLOC_PAGES backend: reserve an aligned address
+// range, commit part of it before use, hand the physical pages of a range
+// back while keeping it mapped and release a whole reservation; map, remap
+// and release serve large allocations directly.
+#   if defined(PALLOC_PAGES)
 #       if defined(_MSC_VER)
-#           include <intrin.h>
+#           include <Windows.h>
 
-static void PALLOC_ATOMIC_STORE( void * volatile * p, void * v )
+static void * PALLOC_STD_PAGES_RESERVE( size_t nbytes, size_t alignment )
 {
-    _InterlockedExchangePointer( p, v );
-}
+    // reservations are aligned to the 64 KB allocation granularity, large
+    // pages need SeLockMemoryPrivilege and are not used
+    (void)alignment;
 
-static void * PALLOC_STD_ATOMIC_LOAD( void * volatile * p )
-{
-    void * o = _InterlockedCompareExchangePointer( p, NULL, NULL );
+    void * p = VirtualAlloc( NULL, nbytes, MEM_RESERVE, PAGE_NOACCESS );
 
-    return o;
+    return p;
 }
 
-static int PALLOC_STD_ATOMIC_COMPARE_EXCHANGE_WEAK( void * volatile * p, void ** e, void * d )
+static int PALLOC_STD_PAGES_COMMIT( void * p, size_t nbytes )
 {
-    void * o = _InterlockedCompareExchangePointer( p, d, *e );
-
-    if( o == *e )
+    if( VirtualAlloc( p, nbytes, MEM_COMMIT, PAGE_READWRITE ) == NULL )
     {
-        return 1;
+        return 0;
     }
 
-    *e = o;
-
-    return 0;
+    return 1;
 }
 
-#       endif
-#   elif defined(PALLOC_THREAD) && defined(PALLOC_MUTEX)
-#       if defined(_MSC_VER)
-#           include <Windows.h>
+static int PALLOC_STD_PAGES_RESET( void * p, size_t nbytes )
+{
+    if( VirtualAlloc( p, nbytes, MEM_RESET, PAGE_READWRITE ) == NULL )
+    {
+        return 0;
+    }
 
-typedef CRITICAL_SECTION PALLOC_STD_MUTEX_T;
+    return 1;
+}
 
-static void PALLOC_STD_MUTEX_INIT( PALLOC_STD_MUTEX_T * l )
+static void PALLOC_STD_PAGES_RELEASE( void * p, size_t nbytes )
 {
-    InitializeCriticalSection( l );
+    (void)nbytes;
+
+    VirtualFree( p, 0, MEM_RELEASE );
 }
 
-static void PALLOC_STD_MUTEX_FINI( PALLOC_STD_MUTEX_T * l )
+static void * PALLOC_STD_PAGES_MAP( size_t nbytes )
 {
-    DeleteCriticalSection( l );
+    void * p = VirtualAlloc( NULL, nbytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE );
+
+    return p;
 }
 
-static void PALLOC_STD_MUTEX_LOCK( PALLOC_STD_MUTEX_T * l )
+static void * PALLOC_STD_PAGES_REMAP( void * p, size_t old_nbytes, size_t new_nbytes )
 {
-    EnterCriticalSection( l );
+    (void)p;
+    (void)old_nbytes;
+    (void)new_nbytes;
+
+    return NULL;
 }
 
-static void PALLOC_STD_MUTEX_UNLOCK( PALLOC_STD_MUTEX_T * l )
+#       else
+#           include <sys/mman.h>
+
+static void * PALLOC_STD_PAGES_RESERVE( size_t nbytes, size_t alignment )
 {
-    LeaveCriticalSection( l );
-}
+#           if defined(PALLOC_PAGES_HUGETLB) && defined(MAP_HUGETLB)
+    // explicit huge pages come from the preallocated hugetlbfs pool and are
+    // naturally aligned to their size; without MAP_NORESERVE the mapping fails
+    // up front when the pool is short and normal pages are used instead
+    void * h = mmap( NULL, nbytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0 );
 
-#      endif
-#   endif
-#endif
+    if( h != MAP_FAILED )
+    {
+        return h;
+    }
+#           endif
 
-#if defined(PALLOC_THREAD)
-#   if !defined(PALLOC_LOCKFREE) && !defined(PALLOC_MUTEX)
-#       error "PALLOC_THREAD requires PALLOC_LOCKFREE or PALLOC_MUTEX"
-#   elif defined(PALLOC_LOCKFREE) && defined(PALLOC_MUTEX)
-#       error "PALLOC_LOCKFREE and PALLOC_MUTEX are mutually exclusive"
-#   endif
-#endif
+    // mmap only guarantees page alignment, so map the slack and unmap it
+    size_t mapped = nbytes + alignment;
 
-#if defined(PALLOC_THREAD) && defined(PALLOC_LOCKFREE)
-#   define PALLOC_THREAD_SENTINEL ((void *)(1))
-#endif
+    unsigned char * m = (unsigned char *)mmap( NULL, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0 );
 
-#define PALLOC_BUFFSIZEOFFSET 2
+    if( m == (unsigned char *)MAP_FAILED )
+    {
+        return NULL;
+    }
 
-#define PALLOC_TYPE_BUFF_T(N) palloc_buff_##N##_t
+    unsigned char * p = (unsigned char *)(((uintptr_t)m + alignment - 1) & ~(uintptr_t)(alignment - 1));
 
-#define PALLOC_TYPE_BLOCK_T(N) palloc_block_##N##_t
+    if( p != m )
+    {
+        munmap( m, (size_t)(p - m) );
+    }
 
-#define PALLOC_DECL_BLOCK(N) \
-    typedef struct PALLOC_TYPE_BLOCK_T(N) { \
-        unsigned char m[PALLOC_BUFFSIZEOFFSET + N]; \
-        struct PALLOC_TYPE_BLOCK_T(N) * n; \
-    } PALLOC_TYPE_BLOCK_T(N)
+    if( p + nbytes != m + mapped )
+    {
+        munmap( p + nbytes, (size_t)(m + mapped - (p + nbytes)) );
+    }
 
-#define PALLOC_TYPE_CHUNK_T(N) palloc_chunk_##N##_t
+#           if defined(PALLOC_PAGES_HUGE) && defined(MADV_HUGEPAGE)
+    madvise( p, nbytes, MADV_HUGEPAGE );
+#           endif
 
-#define PALLOC_DECL_CHUNK(N, K) \
-    typedef struct PALLOC_TYPE_CHUNK_T(N) { \
-        PALLOC_TYPE_BLOCK_T(N) s[K]; \
-    } PALLOC_TYPE_CHUNK_T(N)
+    return p;
+}
 
-#define PALLOC_NAME_GLOBAL_BLOCK(N) g_palloc_block_##N
+static int PALLOC_STD_PAGES_COMMIT( void * p, size_t nbytes )
+{
+    // anonymous mappings are committed page by page on first touch
+    (void)p;
+    (void)nbytes;
 
-#if defined(PALLOC_THREAD) && defined(PALLOC_LOCKFREE)
-#   define PALLOC_DECL_GLOBAL_BLOCK(N) \
-    static PALLOC_TYPE_BLOCK_T( N ) * volatile PALLOC_NAME_GLOBAL_BLOCK( N ) = NULL
-#elif defined(PALLOC_THREAD) && defined(PALLOC_MUTEX)
-#   define PALLOC_NAME_GLOBAL_MUTEX(N) g_palloc_mutex_##N
+    return 1;
+}
 
-#   define PALLOC_DECL_GLOBAL_BLOCK(N) \
-        static PALLOC_STD_MUTEX_T PALLOC_NAME_GLOBAL_MUTEX(N); \
-        static PALLOC_TYPE_BLOCK_T(N) * volatile PALLOC_NAME_GLOBAL_BLOCK(N) = NULL
-#else
-#   define PALLOC_DECL_GLOBAL_BLOCK(N) \
-        static PALLOC_TYPE_BLOCK_T(N) * PALLOC_NAME_GLOBAL_BLOCK(N) = NULL
-#endif
+static int PALLOC_STD_PAGES_RESET( void * p, size_t nbytes )
+{
+    if( madvise( p, nbytes, MADV_DONTNEED ) != 0 )
+    {
+        return 0;
+    }
 
-#define PALLOC_INIT_CHUNK(N) _palloc_init_chunk_##N
+    return 1;
+}
 
-#define PALLOC_DECL_INIT_CHUNK(N, K) \
-    static PALLOC_TYPE_BLOCK_T(N) * PALLOC_INIT_CHUNK(N)( PALLOC_TYPE_CHUNK_T(N) * c ) { \
-        PALLOC_TYPE_BLOCK_T(N) * f = NULL; \
-        for( PALLOC_TYPE_BLOCK_T(N) * it = c->s + 0, \
-            *it_end = c->s + K; \
-            it != it_end; \
-            ++it ) { \
-            it->n = f; \
-            f = it; \
-        } \
-        return f; \
+static void PALLOC_STD_PAGES_RELEASE( void * p, size_t nbytes )
+{
+    munmap( p, nbytes );
+}
+
+static void * PALLOC_STD_PAGES_MAP( size_t nbytes )
+{
+    void * p = mmap( NULL, nbytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+
+    if( p == MAP_FAILED )
+    {
+        return NULL;
     }
 
-#define PALLOC_GET_GLOBAL_BLOCK(N) _palloc_get_global_block_##N
+    return p;
+}
 
-#if defined(PALLOC_THREAD) && defined(PALLOC_LOCKFREE)
-#   define PALLOC_DECL_GET_GLOBAL_BLOCK(N) \
-        static PALLOC_TYPE_BLOCK_T(N) * PALLOC_GET_GLOBAL_BLOCK(N)() { \
-            void * g = PALLOC_STD_ATOMIC_LOAD(&PALLOC_NAME_GLOBAL_BLOCK(N)); \
-            if( g != NULL && g != PALLOC_THREAD_SENTINEL ) { \
-                return g; \
-            } \
-            void * e = NULL; \
-            if( PALLOC_STD_ATOMIC_COMPARE_EXCHANGE_WEAK(&PALLOC_NAME_GLOBAL_BLOCK(N), &e, PALLOC_THREAD_SENTINEL ) == 1) { \
-                PALLOC_TYPE_CHUNK_T(N) * c = (PALLOC_TYPE_CHUNK_T(N) *)PALLOC_STD_MALLOC(sizeof(PALLOC_TYPE_CHUNK_T(N))); \
-                PALLOC_TYPE_BLOCK_T(N) * b = PALLOC_INIT_CHUNK(N)(c); \
-                PALLOC_ATOMIC_STORE(&PALLOC_NAME_GLOBAL_BLOCK(N), b); \
-                return b; \
-            } \
-            do { \
-                g = PALLOC_STD_ATOMIC_LOAD(&PALLOC_NAME_GLOBAL_BLOCK(N)); \
-            } while( g == PALLOC_THREAD_SENTINEL ); \
-            return g; \
-        }
-#else
-#   define PALLOC_DECL_GET_GLOBAL_BLOCK(N) \
-        static PALLOC_TYPE_BLOCK_T(N) * PALLOC_GET_GLOBAL_BLOCK(N)() { \
-            if( PALLOC_NAME_GLOBAL_BLOCK(N) != NULL ) { \
-                return PALLOC_NAME_GLOBAL_BLOCK(N); \
-            } \
-            PALLOC_TYPE_CHUNK_T(N) * c = (PALLOC_TYPE_CHUNK_T(N) *)PALLOC_STD_MALLOC(sizeof(PALLOC_TYPE_CHUNK_T(N))); \
-            PALLOC_TYPE_BLOCK_T(N) * b = PALLOC_INIT_CHUNK(N)(c); \
-            PALLOC_NAME_GLOBAL_BLOCK(N) = b; \
-            return b; \
-        }
+// moves the pages of a mapping to a new size without copying them, NULL
+// where the system cannot do that
+static void * PALLOC_STD_PAGES_REMAP( void * p, size_t old_nbytes, size_t new_nbytes )
+{
+#           if defined(__linux__)
+    void * new_p = mremap( p, old_nbytes, new_nbytes, MREMAP_MAYMOVE );
+
+    if( new_p == MAP_FAILED )
+    {
+        return NULL;
+    }
+
+    return new_p;
+#           else
+    (void)p;
+    (void)old_nbytes;
+    (void)new_nbytes;
+
+    return NULL;
+#           endif
+}
+
+#       endif
+#   endif
 #endif
 
-#define PALLOC_ALLOC_BLOCK(N) _palloc_alloc_block_##N
+#ifndef PALLOC_STD_ASSERT
+#   include <assert.h>
 
-#if defined(PALLOC_THREAD) && defined(PALLOC_LOCKFREE)
-#   define PALLOC_DECL_ALLOC_BLOCK(N) \
-        static unsigned char * PALLOC_ALLOC_BLOCK(N)() { \
-            void * expected; \
-            PALLOC_TYPE_BLOCK_T(N) * b; \
-            do { \
-                do { \
-                    b = (PALLOC_TYPE_BLOCK_T( N ) *)PALLOC_STD_ATOMIC_LOAD( &PALLOC_NAME_GLOBAL_BLOCK( N ) ); \
-                } while( b == PALLOC_THREAD_SENTINEL ); \
-                if( b == NULL ) { \
-                    b = PALLOC_GET_GLOBAL_BLOCK(N)(); \
-                } \
-                expected = b; \
-            } while( !PALLOC_STD_ATOMIC_COMPARE_EXCHANGE_WEAK(&PALLOC_NAME_GLOBAL_BLOCK(N), &expected, b->n)); \
-            return b->m; \
-        }
-#elif defined(PALLOC_THREAD) && defined(PALLOC_MUTEX)
-#   define PALLOC_DECL_ALLOC_BLOCK(N) \
-        static unsigned char * PALLOC_ALLOC_BLOCK(N)() { \
-            PALLOC_STD_MUTEX_LOCK(&PALLOC_NAME_GLOBAL_MUTEX(N)); \
-            PALLOC_TYPE_BLOCK_T(N) * b = PALLOC_GET_GLOBAL_BLOCK(N)(); \
-            PALLOC_NAME_GLOBAL_BLOCK(N) = b->n; \
-            PALLOC_STD_MUTEX_UNLOCK(&PALLOC_NAME_GLOBAL_MUTEX(N)); \
-            unsigned char * m = b->m; \
-            return m; \
-        }
-#else
-#   define PALLOC_DECL_ALLOC_BLOCK(N) \
-        static unsigned char * PALLOC_ALLOC_BLOCK(N)() { \
-            PALLOC_TYPE_BLOCK_T(N) * b = PALLOC_GET_GLOBAL_BLOCK(N)(); \
-            PALLOC_NAME_GLOBAL_BLOCK(N) = b->n; \
-            unsigned char * m = b->m; \
-            return m; \
-        }
+#   define PALLOC_STD_ASSERT(E) assert(E)
 #endif
 
-#define PALLOC_FREE_BLOCK(N) _palloc_free_block_##N
+#include "palloc/psync.h"
 
-#if defined(PALLOC_THREAD) && defined(PALLOC_LOCKFREE)
-#   define PALLOC_DECL_FREE_BLOCK(N) \
-        static void PALLOC_FREE_BLOCK(N)( void * p ) { \
-            PALLOC_TYPE_BLOCK_T(N) * b = (PALLOC_TYPE_BLOCK_T(N) *)(p); \
-            PALLOC_TYPE_BLOCK_T(N) * old_head; \
-            do { \
-                old_head = (PALLOC_TYPE_BLOCK_T(N)*)PALLOC_STD_ATOMIC_LOAD(&PALLOC_NAME_GLOBAL_BLOCK(N)); \
-                b->n = old_head; \
-            } while (!PALLOC_STD_ATOMIC_COMPARE_EXCHANGE_WEAK(&PALLOC_NAME_GLOBAL_BLOCK(N), (void**)&old_head, b)); \
-        }
-#elif defined(PALLOC_THREAD) && defined(PALLOC_MUTEX)
-#   define PALLOC_DECL_FREE_BLOCK(N) \
-        static void PALLOC_FREE_BLOCK(N)( void * p ) { \
-            PALLOC_TYPE_BLOCK_T(N) * b = (PALLOC_TYPE_BLOCK_T(N) *)(p); \
-            PALLOC_STD_MUTEX_LOCK(&PALLOC_NAME_GLOBAL_MUTEX(N)); \
-            b->n = PALLOC_NAME_GLOBAL_BLOCK(N); \
-            PALLOC_NAME_GLOBAL_BLOCK(N) = b; \
-            PALLOC_STD_MUTEX_UNLOCK(&PALLOC_NAME_GLOBAL_MUTEX(N)); \
-        }
-#else
-#   define PALLOC_DECL_FREE_BLOCK(N) \
-        static void PALLOC_FREE_BLOCK(N)( void * p ) { \
-            PALLOC_TYPE_BLOCK_T(N) * b = (PALLOC_TYPE_BLOCK_T(N) *)(p); \
-            b->n = PALLOC_NAME_GLOBAL_BLOCK(N); \
-            PALLOC_NAME_GLOBAL_BLOCK(N) = b; \
-        }
+#define PALLOC_ALIGNMENT 16
+
+#ifndef PALLOC_CACHE_LINE
+#   define PALLOC_CACHE_LINE 64
 #endif
 
-#define PALLOC_DECLARE(N, K) \
-    PALLOC_DECL_BLOCK(N); \
-    PALLOC_DECL_CHUNK(N, K); \
-    PALLOC_DECL_GLOBAL_BLOCK(N); \
-    PALLOC_DECL_INIT_CHUNK(N, K); \
-    PALLOC_DECL_GET_GLOBAL_BLOCK(N); \
-    PALLOC_DECL_ALLOC_BLOCK(N); \
-    PALLOC_DECL_FREE_BLOCK(N)
-
-#define PALLOC_THRESHOLD 2048
-
-#define PALLOC_STD_ALLOC_MARKER (0xffff)
-
-PALLOC_DECLARE( 16, 4096 );
-PALLOC_DECLARE( 32, 2048 );
-PALLOC_DECLARE( 64, 1024 );
-PALLOC_DECLARE( 128, 512 );
-PALLOC_DECLARE( 256, 256 );
-PALLOC_DECLARE( 512, 128 );
-PALLOC_DECLARE( 1024, 64 );
-PALLOC_DECLARE( 2048, 32 );
-
-typedef unsigned char * (*palloc_alloc_func_t)();
-typedef void (*palloc_free_func_t)(void *);
-
-static palloc_alloc_func_t palloc_alloc_table[11] = {
-    &PALLOC_ALLOC_BLOCK( 16 ),
-    &PALLOC_ALLOC_BLOCK( 16 ),
-    &PALLOC_ALLOC_BLOCK( 16 ),
-    &PALLOC_ALLOC_BLOCK( 16 ),
-    &PALLOC_ALLOC_BLOCK( 32 ),
-    &PALLOC_ALLOC_BLOCK( 64 ),
-    &PALLOC_ALLOC_BLOCK( 128 ),
-    &PALLOC_ALLOC_BLOCK( 256 ),
-    &PALLOC_ALLOC_BLOCK( 512 ),
-    &PALLOC_ALLOC_BLOCK( 1024 ),
-    &PALLOC_ALLOC_BLOCK( 2048 )
-};
+#define PALLOC_CHUNK_SHIFT 16
+#define PALLOC_CHUNK_SIZE (1 << PALLOC_CHUNK_SHIFT)
+
+// Size classes too large to carve a few blocks from a single chunk are carved
+// from spans of 2^order chunks. A span is aligned to its size like a chunk is
+// to its own, so a block finds the start of its span by masking its address.
+#define PALLOC_SPAN_ORDERS 5
+#define PALLOC_SPAN_SIZE(O) ((size_t)PALLOC_CHUNK_SIZE << (O))
+
+#define PALLOC_THRESHOLD (256 << 10)
+
+// Size classes: 16-byte steps up to 64 bytes, then four classes per power
+// of two up to PALLOC_THRESHOLD. This list is the only definition, every
+// table below is generated from it and each entry is checked against the
+// PALLOC_CLASS_SIZE formula that palloc_index inverts.
+#define PALLOC_CLASSES(X) \
+    X(0, 16) X(1, 32) X(2, 48) X(3, 64) \
+    X(4, 80) X(5, 96) X(6, 112) X(7, 128) \
+    X(8, 160) X(9, 192) X(10, 224) X(11, 256) \
+    X(12, 320) X(13, 384) X(14, 448) X(15, 512) \
+    X(16, 640) X(17, 768) X(18, 896) X(19, 1024) \
+    X(20, 1280) X(21, 1536) X(22, 1792) X(23, 2048) \
+    X(24, 2560) X(25, 3072) X(26, 3584) X(27, 4096) \
+    X(28, 5120) X(29, 6144) X(30, 7168) X(31, 8192) \
+    X(32, 10240) X(33, 12288) X(34, 14336) X(35, 16384) \
+    X(36, 20480) X(37, 24576) X(38, 28672) X(39, 32768) \
+    X(40, 40960) X(41, 49152) X(42, 57344) X(43, 65536) \
+    X(44, 81920) X(45, 98304) X(46, 114688) X(47, 131072) \
+    X(48, 163840) X(49, 196608) X(50, 229376) X(51, 262144)
+
+#define PALLOC_CLASS_COUNT 52
+
+#define PALLOC_CLASS_SIZE(I) ((I) < 4 ? 16 * ((I) + 1) : (5 + (I) % 4) << ((I) / 4 + 3))
+
+// Classes up to 16 KB fit at least four blocks into a chunk, the larger ones
+// are carved from spans of 4 to 6 blocks.
+#define PALLOC_CLASS_ORDER(I) ((I) < 36 ? 0 : (I) / 4 - 8)
+
+typedef char palloc_check_class_order[PALLOC_CLASS_ORDER( PALLOC_CLASS_COUNT - 1 ) < PALLOC_SPAN_ORDERS ? 1 : -1];
+
+// PALLOC_PAGES carves chunks and spans out of large reservations made with the
+// page primitives instead of asking the C heap for every one of them. Released
+// chunks and spans keep their address range: the pages past the first one are
+// handed back to the system and they are linked into the free list of their
+// order for the next refill.
+// With PALLOC_PAGES_HUGE the reservations are aligned to and advised for
+// transparent huge pages, and released spans only hand back the whole huge
+// pages past their first page.
+#if defined(PALLOC_PAGES)
+#   ifndef PALLOC_PAGES_REGION_SIZE
+#       define PALLOC_PAGES_REGION_SIZE (32 << 20)
+#   endif
 
-static palloc_free_func_t palloc_free_table[11] = {
-    &PALLOC_FREE_BLOCK( 16 ),
-    &PALLOC_FREE_BLOCK( 16 ),
-    &PALLOC_FREE_BLOCK( 16 ),
-    &PALLOC_FREE_BLOCK( 16 ),
-    &PALLOC_FREE_BLOCK( 32 ),
-    &PALLOC_FREE_BLOCK( 64 ),
-    &PALLOC_FREE_BLOCK( 128 ),
-    &PALLOC_FREE_BLOCK( 256 ),
-    &PALLOC_FREE_BLOCK( 512 ),
-    &PALLOC_FREE_BLOCK( 1024 ),
-    &PALLOC_FREE_BLOCK( 2048 )
-};
+#   define PALLOC_PAGES_PAGE_SIZE 4096
 
-const int palloc_index_table[2048] = {
-    -1, 0, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3,
-    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
-    5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,
-    5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,
-    6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
-    6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
-    6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
-    6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
-    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
-    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
-    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
-    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
-    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
-    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
-    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
-    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
-    8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
-    8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
-    8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
-    8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
-    8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
-    8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
-    8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
-    8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
-    8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
-    8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
-    8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
-    8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
-    8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
-    8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
-    8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
-    8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
-    9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
-    9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
-    9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
-    9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
-    9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
-    9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
-    9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
-    9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
-    9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
-    9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
-    9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
-    9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
-    9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
-    9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
-    9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
-    9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
-    9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
-    9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
-    9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
-    9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
-    9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
-    9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
-    9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
-    9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
-    9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
-    9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
-    9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
-    9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
-    9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
-    9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
-    9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
-    9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
-};
+#   if defined(PALLOC_PAGES_HUGE)
+#       define PALLOC_PAGES_ALIGNMENT (2 << 20)
+#   else
+#       define PALLOC_PAGES_ALIGNMENT PALLOC_CHUNK_SIZE
+#   endif
+
+// huge pages are only handed back whole
+#   if defined(PALLOC_PAGES_HUGE) || defined(PALLOC_PAGES_HUGETLB)
+#       define PALLOC_PAGES_RESET_SIZE (2 << 20)
+#   else
+#       define PALLOC_PAGES_RESET_SIZE PALLOC_PAGES_PAGE_SIZE
+#   endif
 
-#define PALLOC_INDEX(N) palloc_index_table[N]
-#define PALLOC_ALLOC(I) (*palloc_alloc_table[I])();
-#define PALLOC_FREE(I, Q) (*palloc_free_table[I])(Q);
+typedef char palloc_check_pages_region[PALLOC_PAGES_REGION_SIZE % PALLOC_PAGES_ALIGNMENT == 0 ? 1 : -1];
+typedef char palloc_check_pages_span[PALLOC_PAGES_REGION_SIZE >= 2 * PALLOC_SPAN_SIZE( PALLOC_SPAN_ORDERS - 1 ) ? 1 : -1];
 
-static unsigned char * palloc_qp( unsigned char * q, size_t nbytes )
+typedef struct palloc_pages_chunk_t
 {
-    unsigned char * p = q;
-    *p++ = nbytes & 0xff;
-    *p++ = (nbytes >> 8) & 0xff;
+    struct palloc_pages_chunk_t * next;
+} palloc_pages_chunk_t;
+
+static unsigned char * g_palloc_pages_cursor = NULL;
+static unsigned char * g_palloc_pages_end = NULL;
+static palloc_pages_chunk_t * g_palloc_pages_free[PALLOC_SPAN_ORDERS];
+static unsigned char ** g_palloc_pages_regions = NULL;
+static size_t g_palloc_pages_region_count = 0;
+static size_t g_palloc_pages_region_capacity = 0;
+
+// Refills are rare, so the backend takes a lock in every threading mode; in
+// lock-free builds it is a spin lock on a 64-bit word. Waiters spin on loads
+// and only try the exchange once the lock reads free, so they do not keep
+// pulling the line away from the holder.
+#   if defined(PALLOC_THREAD) && defined(PALLOC_LOCKFREE)
+static PALLOC_STD_ATOMIC64_T g_palloc_pages_lock = 0;
 
-    return p;
+static void palloc_pages_lock()
+{
+    for( ;; )
+    {
+        unsigned long long e = 0;
+        if( PALLOC_STD_ATOMIC_LOAD64( &g_palloc_pages_lock ) == 0 && PALLOC_STD_ATOMIC_COMPARE_EXCHANGE64_WEAK( &g_palloc_pages_lock, &e, 1 ) != 0 )
+        {
+            return;
+        }
+
+        PALLOC_STD_YIELD();
+    }
 }
 
-static unsigned char * palloc_pq( unsigned char * p, size_t * const nbytes )
+static void palloc_pages_unlock()
 {
-    unsigned char * q = p;
-    size_t hbytes = *(--q);
-    size_t lbytes = *(--q);
-    
-    *nbytes = (hbytes << 8) | lbytes;
+    PALLOC_STD_ATOMIC_STORE64( &g_palloc_pages_lock, 0 );
+}
+#   elif defined(PALLOC_THREAD) && defined(PALLOC_MUTEX)
+static PALLOC_STD_MUTEX_T g_palloc_pages_mutex;
 
-    return q;
+static void palloc_pages_lock()
+{
+    PALLOC_STD_MUTEX_LOCK( &g_palloc_pages_mutex );
 }
 
-void PINIT()
+static void palloc_pages_unlock()
+{
+    PALLOC_STD_MUTEX_UNLOCK( &g_palloc_pages_mutex );
+}
+#   else
+static void palloc_pages_lock()
 {
-#if defined(PALLOC_THREAD) && defined(PALLOC_MUTEX)
-    PALLOC_STD_MUTEX_INIT( &PALLOC_NAME_GLOBAL_MUTEX( 16 ) );
-    PALLOC_STD_MUTEX_INIT( &PALLOC_NAME_GLOBAL_MUTEX( 32 ) );
-    PALLOC_STD_MUTEX_INIT( &PALLOC_NAME_GLOBAL_MUTEX( 64 ) );
-    PALLOC_STD_MUTEX_INIT( &PALLOC_NAME_GLOBAL_MUTEX( 128 ) );
-    PALLOC_STD_MUTEX_INIT( &PALLOC_NAME_GLOBAL_MUTEX( 256 ) );
-    PALLOC_STD_MUTEX_INIT( &PALLOC_NAME_GLOBAL_MUTEX( 512 ) );
-    PALLOC_STD_MUTEX_INIT( &PALLOC_NAME_GLOBAL_MUTEX( 1024 ) );
-    PALLOC_STD_MUTEX_INIT( &PALLOC_NAME_GLOBAL_MUTEX( 2048 ) );
-#endif    
 }
 
-void PFINI()
+static void palloc_pages_unlock()
 {
-#if defined(PALLOC_THREAD) && defined(PALLOC_MUTEX)
-    PALLOC_STD_MUTEX_FINI( &PALLOC_NAME_GLOBAL_MUTEX( 16 ) );
-    PALLOC_STD_MUTEX_FINI( &PALLOC_NAME_GLOBAL_MUTEX( 32 ) );
-    PALLOC_STD_MUTEX_FINI( &PALLOC_NAME_GLOBAL_MUTEX( 64 ) );
-    PALLOC_STD_MUTEX_FINI( &PALLOC_NAME_GLOBAL_MUTEX( 128 ) );
-    PALLOC_STD_MUTEX_FINI( &PALLOC_NAME_GLOBAL_MUTEX( 256 ) );
-    PALLOC_STD_MUTEX_FINI( &PALLOC_NAME_GLOBAL_MUTEX( 512 ) );
-    PALLOC_STD_MUTEX_FINI( &PALLOC_NAME_GLOBAL_MUTEX( 1024 ) );
-    PALLOC_STD_MUTEX_FINI( &PALLOC_NAME_GLOBAL_MUTEX( 2048 ) );
-#endif
 }
+#   endif
 
-void * PALLOC( size_t nbytes )
+static int palloc_pages_grow()
 {
-    if( nbytes == 0 )
+    if( g_palloc_pages_region_count == g_palloc_pages_region_capacity )
     {
-        nbytes = 1;
-    }
+        size_t capacity = g_palloc_pages_region_capacity == 0 ? 16 : 2 * g_palloc_pages_region_capacity;
 
-    if( nbytes >= PALLOC_THRESHOLD )
-    {
-        unsigned char * q = (unsigned char *)PALLOC_STD_MALLOC( nbytes + PALLOC_BUFFSIZEOFFSET );
-        
-        unsigned char * p = palloc_qp( q, PALLOC_STD_ALLOC_MARKER );
+        unsigned char ** regions = (unsigned char **)PALLOC_STD_REALLOC( g_palloc_pages_regions, capacity * sizeof( unsigned char * ) );
 
-        return (void *)p;
+        if( regions == NULL )
+        {
+            return 0;
+        }
+
+        g_palloc_pages_regions = regions;
+        g_palloc_pages_region_capacity = capacity;
     }
 
-    int index = PALLOC_INDEX( nbytes );
+    unsigned char * r = (unsigned char *)PALLOC_STD_PAGES_RESERVE( PALLOC_PAGES_REGION_SIZE, PALLOC_PAGES_ALIGNMENT );
+
+    if( r == NULL )
+    {
+        return 0;
+    }
 
-    unsigned char * q = PALLOC_ALLOC( index );
+    g_palloc_pages_regions[g_palloc_pages_region_count++] = r;
 
-    unsigned char * p = palloc_qp( q, nbytes );
+    g_palloc_pages_cursor = r;
+    g_palloc_pages_end = r + PALLOC_PAGES_REGION_SIZE;
 
-    return (void *)p;
+    return 1;
 }
 
-void PFREE( void * p )
+// links the chunks between the cursor and end into the chunk free list, called
+// with the lock held
+static void palloc_pages_skip( unsigned char * end )
 {
-    if( p == NULL )
+    for( ; g_palloc_pages_cursor != end; g_palloc_pages_cursor += PALLOC_CHUNK_SIZE )
     {
-        return;
-    }
-
-    size_t nbytes;
-    unsigned char * q = palloc_pq( p, &nbytes );
+        if( PALLOC_STD_PAGES_COMMIT( g_palloc_pages_cursor, PALLOC_CHUNK_SIZE ) == 0 )
+        {
+            continue;
+        }
 
-    if( nbytes == PALLOC_STD_ALLOC_MARKER )
-    {
-        PALLOC_STD_FREE( q );
+        palloc_pages_chunk_t * f = (palloc_pages_chunk_t *)g_palloc_pages_cursor;
 
-        return;
+        f->next = g_palloc_pages_free[0];
+        g_palloc_pages_free[0] = f;
     }
-
-    int index = PALLOC_INDEX( nbytes );
-
-    PALLOC_FREE( index, q );
 }
 
-void * PREALLOC( void * p, size_t nbytes )
+// Spans carved at the cursor are freshly committed and read as zero, which
+// is reported through zero unless it is NULL. Spans of a free list are not:
+// their first page holds the link and a reset does not clear the others on
+// every system.
+static void * palloc_pages_alloc( unsigned int order, int * zero )
 {
-    if( p == NULL )
-    {
-        void * new_p = PALLOC( nbytes );
+    size_t nbytes = PALLOC_SPAN_SIZE( order );
 
-        return new_p;
-    }
+    palloc_pages_lock();
 
-    if( nbytes == 0 )
+    palloc_pages_chunk_t * f = g_palloc_pages_free[order];
+
+    if( f != NULL )
     {
-        nbytes = 1;
-    }
+        g_palloc_pages_free[order] = f->next;
 
-    size_t old_nbytes;
-    unsigned char * old_q = palloc_pq( p, &old_nbytes );
+        palloc_pages_unlock();
 
-    if( old_nbytes == nbytes )
-    {
-        return p;
+        if( zero != NULL )
+        {
+            *zero = 0;
+        }
+
+        return f;
     }
 
-    if( nbytes >= PALLOC_THRESHOLD )
+    // the chunks skipped to align a span and the tail of a region too short
+    // for it go to the chunk free list
+    uintptr_t c = ((uintptr_t)g_palloc_pages_cursor + nbytes - 1) & ~(uintptr_t)(nbytes - 1);
+
+    if( c + nbytes > (uintptr_t)g_palloc_pages_end )
     {
-        if( old_nbytes == PALLOC_STD_ALLOC_MARKER )
-        {
-            unsigned char * new_q = (unsigned char *)PALLOC_STD_REALLOC( old_q, nbytes + PALLOC_BUFFSIZEOFFSET );
+        palloc_pages_skip( g_palloc_pages_end );
 
-            unsigned char * new_p = palloc_qp( new_q, PALLOC_STD_ALLOC_MARKER );
+        if( palloc_pages_grow() == 0 )
+        {
+            palloc_pages_unlock();
 
-            return new_p;
+            return NULL;
         }
 
-        unsigned char * new_q = (unsigned char *)PALLOC_STD_MALLOC( nbytes + PALLOC_BUFFSIZEOFFSET );
+        c = ((uintptr_t)g_palloc_pages_cursor + nbytes - 1) & ~(uintptr_t)(nbytes - 1);
+    }
 
-        unsigned char * new_p = palloc_qp( new_q, PALLOC_STD_ALLOC_MARKER );
+    palloc_pages_skip( (unsigned char *)c );
 
-        PALLOC_STD_MEMCPY( new_p, p, old_nbytes );
+    g_palloc_pages_cursor += nbytes;
 
-        int old_index = PALLOC_INDEX( old_nbytes );
+    palloc_pages_unlock();
 
-        PALLOC_FREE( old_index, old_q );
+    if( PALLOC_STD_PAGES_COMMIT( (void *)c, nbytes ) == 0 )
+    {
+        return NULL;
+    }
 
-        return new_p;
+    if( zero != NULL )
+    {
+        *zero = 1;
     }
 
-    int new_index = PALLOC_INDEX( nbytes );
+    return (void *)c;
+}
 
-    if( old_nbytes == PALLOC_STD_ALLOC_MARKER )
+static void palloc_pages_free( void * p, unsigned int order )
+{
+    // the first page stays resident for the free list link; with huge pages
+    // spans smaller than one keep all of theirs
+    uintptr_t b = ((uintptr_t)p + PALLOC_PAGES_PAGE_SIZE + PALLOC_PAGES_RESET_SIZE - 1) & ~(uintptr_t)(PALLOC_PAGES_RESET_SIZE - 1);
+    uintptr_t e = (uintptr_t)p + PALLOC_SPAN_SIZE( order );
+
+    if( b < e )
     {
-        unsigned char * new_q = PALLOC_ALLOC( new_index );
+        int reset = PALLOC_STD_PAGES_RESET( (void *)b, (size_t)(e - b) );
 
-        unsigned char * new_p = palloc_qp( new_q, nbytes );
+        PALLOC_STD_ASSERT( reset != 0 );
+        (void)reset;
+    }
 
-        PALLOC_STD_MEMCPY( new_p, p, nbytes );
+    palloc_pages_chunk_t * f = (palloc_pages_chunk_t *)p;
 
-        PALLOC_STD_FREE( old_q );
+    palloc_pages_lock();
 
-        return new_p;
-    }
+    f->next = g_palloc_pages_free[order];
+    g_palloc_pages_free[order] = f;
 
-    int old_index = PALLOC_INDEX( old_nbytes );
+    palloc_pages_unlock();
+}
 
-    if( old_index == new_index )
+static void palloc_pages_fini()
+{
+    for( size_t i = 0; i != g_palloc_pages_region_count; ++i )
     {
-        return p;
+        PALLOC_STD_PAGES_RELEASE( g_palloc_pages_regions[i], PALLOC_PAGES_REGION_SIZE );
     }
 
-    unsigned char * new_q = PALLOC_ALLOC( new_index );
+    PALLOC_STD_FREE( g_palloc_pages_regions );
 
-    unsigned char * new_p = palloc_qp( new_q, nbytes );
+    g_palloc_pages_cursor = NULL;
+    g_palloc_pages_end = NULL;
+    PALLOC_STD_MEMSET( (void *)g_palloc_pages_free, 0, sizeof( g_palloc_pages_free ) );
+    g_palloc_pages_regions = NULL;
+    g_palloc_pages_region_count = 0;
+    g_palloc_pages_region_capacity = 0;
+}
+#endif
 
-    size_t min_nbytes = old_nbytes < nbytes ? old_nbytes : nbytes;
-    PALLOC_STD_MEMCPY( new_p, p, min_nbytes );
+// Chunk and span backend, a configuration may route it to its own page
+// allocator. Spans of order 0 are chunks. PALLOC_STD_SPAN_ALLOC_ZERO also
+// sets Z to 1 if the span is known to read as zero and to 0 otherwise.
+#ifndef PALLOC_STD_CHUNK_ALLOC
+#   if defined(PALLOC_PAGES)
+#       define PALLOC_STD_CHUNK_ALLOC() palloc_pages_alloc(0, NULL)
+#       define PALLOC_STD_CHUNK_FREE(P) palloc_pages_free(P, 0)
+#   else
+#       define PALLOC_STD_CHUNK_ALLOC() PALLOC_STD_ALIGNED_MALLOC(PALLOC_CHUNK_SIZE, PALLOC_CHUNK_SIZE)
+#       define PALLOC_STD_CHUNK_FREE(P) PALLOC_STD_ALIGNED_FREE(P)
+#   endif
+#endif
+
+#ifndef PALLOC_STD_SPAN_ALLOC
+#   if defined(PALLOC_PAGES)
+#       define PALLOC_STD_SPAN_ALLOC(O) palloc_pages_alloc(O, NULL)
+#       define PALLOC_STD_SPAN_ALLOC_ZERO(O, Z) palloc_pages_alloc(O, Z)
+#       define PALLOC_STD_SPAN_FREE(P, O) palloc_pages_free(P, O)
+#   else
+#       define PALLOC_STD_SPAN_ALLOC(O) ((O) == 0 ? PALLOC_STD_CHUNK_ALLOC() : PALLOC_STD_ALIGNED_MALLOC(PALLOC_SPAN_SIZE(O), PALLOC_SPAN_SIZE(O)))
+#       define PALLOC_STD_SPAN_FREE(P, O) ((O) == 0 ? PALLOC_STD_CHUNK_FREE(P) : PALLOC_STD_ALIGNED_FREE(P))
+#   endif
+#endif
 
-    PALLOC_FREE( old_index, old_q );
+#ifndef PALLOC_STD_SPAN_ALLOC_ZERO
+#   define PALLOC_STD_SPAN_ALLOC_ZERO(O, Z) (*(Z) = 0, PALLOC_STD_SPAN_ALLOC(O))
+#endif
 
-    return new_p;
-}
\ No newline at end of file
+// PALLOC_MUTEX splits the free list of every class into shards and every chunk
+// belongs to the shard that carved it.
+#if defined(PALLOC_THREAD) && defined(PALLOC_MUTEX)
+#   ifndef PALLOC_SHARD_BITS
+#       define PALLOC_SHARD_BITS 3
+#   endif
+
+#   define PALLOC_SHARD_COUNT (1 << PALLOC_SHARD_BITS)
+
+typedef char palloc_check_shard_bits[PALLOC_SHARD_BITS <= 8 ? 1 : -1];
+#endif
+
+// PALLOC_NUMA splits the shards into one group per NUMA node, nodes beyond
+// PALLOC_NUMA_NODES share groups. A thread allocates from a shard of the group
+// of the node it runs on and refills from the shards of that group only, the
+// pages of the spans a group carves are preferred on its node, and blocks
+// freed on another node go back to the remote list of the shard that owns
+// them. On a single node, or without libnuma, the group is all shards.
+#if defined(PALLOC_THREAD) && defined(PALLOC_MUTEX) && defined(PALLOC_NUMA)
+#   ifndef PALLOC_NUMA_BITS
+#       define PALLOC_NUMA_BITS 1
+#   endif
+
+#   define PALLOC_NUMA_NODES (1 << PALLOC_NUMA_BITS)
+
+typedef char palloc_check_numa_bits[PALLOC_NUMA_BITS >= 1 && PALLOC_NUMA_BITS <= PALLOC_SHARD_BITS ? 1 : -1];
+
+// Node count, node of the running thread and a preference of a range of
+// pages for a node. libnuma sets itself up in a constructor, which under
+// LD_PRELOAD runs after palloc's first allocation; until then it is treated
+// as a single node.
+#   ifndef PALLOC_STD_NUMA_NODE
+#       if defined(PALLOC_NUMA_LIBNUMA)
+#           include <numa.h>
+#           include <numaif.h>
+#           include <sched.h>
+
+static int PALLOC_STD_NUMA_NODES()
+{
+    if( numa_all_nodes_ptr == NULL || numa_available() < 0 )
+    {
+        return 1;
+    }
+
+    int nodes = numa_max_node() + 1;
+
+    return nodes;
+}
+
+static int PALLOC_STD_NUMA_NODE()
+{
+    if( numa_all_nodes_ptr == NULL )
+    {
+        return 0;
+    }
+
+    int cpu = sched_getcpu();
+
+    int node = cpu < 0 ? -1 : numa_node_of_cpu( cpu );
+
+    return node < 0 ? 0 : node;
+}
+
+static void PALLOC_STD_NUMA_PREFER( void * p, size_t nbytes, int node )
+{
+    unsigned long mask = 1UL << node;
+
+    mbind( p, nbytes, MPOL_PREFERRED, &mask, sizeof( mask ) * 8, 0 );
+}
+#       else
+#           define PALLOC_STD_NUMA_NODES() 1
+#           define PALLOC_STD_NUMA_NODE() 0
+#           define PALLOC_STD_NUMA_PREFER(P, S, N) ((void)0)
+#       endif
+#   endif
+
+#   define PALLOC_NUMA_UNKNOWN 0xffffffffu
+
+// the low bits of a shard index that the thread hash picks, the bits above
+// them are the group
+static unsigned int g_palloc_numa_shift = PALLOC_SHARD_BITS;
+static int g_palloc_numa_prefer = 0;
+
+static PALLOC_STD_TLS unsigned int t_palloc_numa_group = PALLOC_NUMA_UNKNOWN;
+
+// The group of a thread is looked up before its first allocation and again
+// on every refill, so a thread moved to another node follows it. The query
+// may allocate, the group is valid before it runs.
+static PALLOC_NOINLINE unsigned int palloc_numa_refresh()
+{
+    unsigned int group = 0;
+
+    t_palloc_numa_group = group;
+
+    if( g_palloc_numa_shift != PALLOC_SHARD_BITS )
+    {
+        group = (unsigned int)PALLOC_STD_NUMA_NODE() & (PALLOC_NUMA_NODES - 1);
+
+        t_palloc_numa_group = group;
+    }
+
+    return group;
+}
+
+static void palloc_numa_init()
+{
+    // the first query sets up the tables of the node library while every
+    // thread is still in the single group
+    (void)PALLOC_STD_NUMA_NODE();
+
+    int nodes = PALLOC_STD_NUMA_NODES();
+
+    g_palloc_numa_shift = nodes > 1 ? PALLOC_SHARD_BITS - PALLOC_NUMA_BITS : PALLOC_SHARD_BITS;
+    g_palloc_numa_prefer = nodes > 1 && nodes <= PALLOC_NUMA_NODES;
+
+    t_palloc_numa_group = PALLOC_NUMA_UNKNOWN;
+}
+
+#   define PALLOC_SHARD_GROUP() (1u << g_palloc_numa_shift)
+#   define PALLOC_NUMA_REFRESH() palloc_numa_refresh()
+#elif defined(PALLOC_THREAD) && defined(PALLOC_MUTEX)
+#   define PALLOC_SHARD_GROUP() ((unsigned int)PALLOC_SHARD_COUNT)
+#   define PALLOC_NUMA_REFRESH() ((void)0)
+#endif
+
+// A chunk map entry holds the size class plus one in the low seven bits of
+// its low byte and the shard that owns the chunk in its high byte. The top bit
+// of the low byte marks chunks that read as zero when they were carved.
+typedef unsigned short palloc_map_entry_t;
+
+#define PALLOC_MAP_CLASS_BITS 8
+#define PALLOC_MAP_CLASS_MASK ((1 << (PALLOC_MAP_CLASS_BITS - 1)) - 1)
+#define PALLOC_MAP_ZERO (1 << (PALLOC_MAP_CLASS_BITS - 1))
+
+#define PALLOC_MAP_ENTRY(I, O, Z) (palloc_map_entry_t)(((unsigned int)(O) << PALLOC_MAP_CLASS_BITS) | ((Z) != 0 ? PALLOC_MAP_ZERO : 0) | (unsigned int)((I) + 1))
+
+typedef char palloc_check_map_class[PALLOC_CLASS_COUNT < PALLOC_MAP_CLASS_MASK ? 1 : -1];
+
+// ptrim counts the free blocks of every chunk of a class; the chunk map lists
+// those chunks in address order so each block finds its chunk by binary search.
+// palloc_map_chunks returns the number of chunks of a class and writes the
+// first capacity of them. A span counts as one chunk at its start.
+typedef struct palloc_trim_t
+{
+    uintptr_t chunk;
+    size_t count;
+} palloc_trim_t;
+
+// Chunks are PALLOC_CHUNK_SIZE aligned and the chunk map records the size
+// class (plus one) of every chunk-sized slot of the address space, so PFREE
+// finds the class of a block from its address alone; every slot of a span
+// records its class. Zero means the memory is not a palloc chunk, i.e. a large
+// allocation.
+#if UINTPTR_MAX > 0xffffffffu
+#   define PALLOC_MAP_ADDRESS_BITS 48
+#   define PALLOC_MAP_LEAF_SHIFT 31
+#   define PALLOC_MAP_ROOT_SIZE (1 << (PALLOC_MAP_ADDRESS_BITS - PALLOC_MAP_LEAF_SHIFT))
+#   define PALLOC_MAP_LEAF_SIZE (1 << (PALLOC_MAP_LEAF_SHIFT - PALLOC_CHUNK_SHIFT))
+
+// leaves come from the chunk backend like the blocks they describe
+typedef char palloc_check_map_leaf[PALLOC_MAP_LEAF_SIZE * sizeof( palloc_map_entry_t ) == PALLOC_CHUNK_SIZE ? 1 : -1];
+
+#   if defined(PALLOC_THREAD) && defined(PALLOC_LOCKFREE)
+static PALLOC_STD_ATOMIC64_T g_palloc_map[PALLOC_MAP_ROOT_SIZE];
+#   elif defined(PALLOC_THREAD) && defined(PALLOC_MUTEX)
+static PALLOC_STD_MUTEX_T g_palloc_map_mutex;
+static palloc_map_entry_t * volatile g_palloc_map[PALLOC_MAP_ROOT_SIZE];
+#   else
+static palloc_map_entry_t * g_palloc_map[PALLOC_MAP_ROOT_SIZE];
+#   endif
+
+static palloc_map_entry_t * palloc_map_leaf( uintptr_t a )
+{
+#   if defined(PALLOC_THREAD) && defined(PALLOC_LOCKFREE)
+    palloc_map_entry_t * leaf = (palloc_map_entry_t *)(uintptr_t)PALLOC_STD_ATOMIC_LOAD64( g_palloc_map + (a >> PALLOC_MAP_LEAF_SHIFT) );
+#   else
+    palloc_map_entry_t * leaf = g_palloc_map[a >> PALLOC_MAP_LEAF_SHIFT];
+#   endif
+
+    return leaf;
+}
+
+static palloc_map_entry_t * palloc_map_grow( uintptr_t a )
+{
+    palloc_map_entry_t * leaf = (palloc_map_entry_t *)PALLOC_STD_CHUNK_ALLOC();
+    PALLOC_STD_MEMSET( leaf, 0, PALLOC_CHUNK_SIZE );
+
+#   if defined(PALLOC_THREAD) && defined(PALLOC_LOCKFREE)
+    unsigned long long e = 0;
+    while( PALLOC_STD_ATOMIC_COMPARE_EXCHANGE64_WEAK( g_palloc_map + (a >> PALLOC_MAP_LEAF_SHIFT), &e, (unsigned long long)(uintptr_t)leaf ) == 0 )
+    {
+        if( e != 0 )
+        {
+            PALLOC_STD_CHUNK_FREE( leaf );
+
+            return (palloc_map_entry_t *)(uintptr_t)e;
+        }
+    }
+#   elif defined(PALLOC_THREAD) && defined(PALLOC_MUTEX)
+    PALLOC_STD_MUTEX_LOCK( &g_palloc_map_mutex );
+
+    palloc_map_entry_t * e = g_palloc_map[a >> PALLOC_MAP_LEAF_SHIFT];
+
+    if( e == NULL )
+    {
+        g_palloc_map[a >> PALLOC_MAP_LEAF_SHIFT] = leaf;
+    }
+
+    PALLOC_STD_MUTEX_UNLOCK( &g_palloc_map_mutex );
+
+    if( e != NULL )
+    {
+        PALLOC_STD_CHUNK_FREE( leaf );
+
+        return e;
+    }
+#   else
+    g_palloc_map[a >> PALLOC_MAP_LEAF_SHIFT] = leaf;
+#   endif
+
+    return leaf;
+}
+
+static int palloc_map_index( const void * p )
+{
+    uintptr_t a = (uintptr_t)p;
+
+    if( (a >> PALLOC_MAP_ADDRESS_BITS) != 0 )
+    {
+        return -1;
+    }
+
+    palloc_map_entry_t * leaf = palloc_map_leaf( a );
+
+    if( leaf == NULL )
+    {
+        return -1;
+    }
+
+    int index = (int)(leaf[(a >> PALLOC_CHUNK_SHIFT) & (PALLOC_MAP_LEAF_SIZE - 1)] & PALLOC_MAP_CLASS_MASK) - 1;
+
+    return index;
+}
+
+// only called for blocks of palloc chunks
+static PALLOC_FORCEINLINE unsigned int palloc_map_owner( const void * p )
+{
+    uintptr_t a = (uintptr_t)p;
+
+    unsigned int owner = (unsigned int)palloc_map_leaf( a )[(a >> PALLOC_CHUNK_SHIFT) & (PALLOC_MAP_LEAF_SIZE - 1)] >> PALLOC_MAP_CLASS_BITS;
+
+    return owner;
+}
+
+static PALLOC_FORCEINLINE int palloc_map_zero( const void * p )
+{
+    uintptr_t a = (uintptr_t)p;
+
+    int zero = (palloc_map_leaf( a )[(a >> PALLOC_CHUNK_SHIFT) & (PALLOC_MAP_LEAF_SIZE - 1)] & PALLOC_MAP_ZERO) != 0;
+
+    return zero;
+}
+
+static void palloc_map_set( const void * p, int index, unsigned int owner, int zero )
+{
+    uintptr_t a = (uintptr_t)p;
+
+    palloc_map_entry_t * leaf = palloc_map_leaf( a );
+
+    if( leaf == NULL )
+    {
+        leaf = palloc_map_grow( a );
+    }
+
+    leaf[(a >> PALLOC_CHUNK_SHIFT) & (PALLOC_MAP_LEAF_SIZE - 1)] = index == -1 ? 0 : PALLOC_MAP_ENTRY(index, owner, zero);
+}
+
+static size_t palloc_map_chunks( int index, palloc_trim_t * chunks, size_t capacity )
+{
+    size_t count = 0;
+
+    for( uintptr_t r = 0; r != PALLOC_MAP_ROOT_SIZE; ++r )
+    {
+        palloc_map_entry_t * leaf = palloc_map_leaf( r << PALLOC_MAP_LEAF_SHIFT );
+
+        if( leaf == NULL )
+        {
+            continue;
+        }
+
+        for( uintptr_t i = 0; i != PALLOC_MAP_LEAF_SIZE; i += (uintptr_t)1 << PALLOC_CLASS_ORDER( index ) )
+        {
+            if( (leaf[i] & PALLOC_MAP_CLASS_MASK) != index + 1 )
+            {
+                continue;
+            }
+
+            if( count < capacity )
+            {
+                chunks[count].chunk = (r << PALLOC_MAP_LEAF_SHIFT) | (i << PALLOC_CHUNK_SHIFT);
+                chunks[count].count = 0;
+            }
+
+            ++count;
+        }
+    }
+
+    return count;
+}
+
+static void palloc_map_fini()
+{
+    for( uintptr_t r = 0; r != PALLOC_MAP_ROOT_SIZE; ++r )
+    {
+        palloc_map_entry_t * leaf = palloc_map_leaf( r << PALLOC_MAP_LEAF_SHIFT );
+
+        if( leaf == NULL )
+        {
+            continue;
+        }
+
+        for( uintptr_t i = 0; i != PALLOC_MAP_LEAF_SIZE; )
+        {
+            if( leaf[i] == 0 )
+            {
+                ++i;
+
+                continue;
+            }
+
+            unsigned int order = PALLOC_CLASS_ORDER( (leaf[i] & PALLOC_MAP_CLASS_MASK) - 1 );
+
+            PALLOC_STD_SPAN_FREE( (void *)((r << PALLOC_MAP_LEAF_SHIFT) | (i << PALLOC_CHUNK_SHIFT)), order );
+
+            i += (uintptr_t)1 << order;
+        }
+
+        PALLOC_STD_CHUNK_FREE( leaf );
+
+        g_palloc_map[r] = 0;
+    }
+}
+#else
+static palloc_map_entry_t g_palloc_map[1 << (32 - PALLOC_CHUNK_SHIFT)];
+
+static int palloc_map_index( const void * p )
+{
+    uintptr_t a = (uintptr_t)p;
+
+    int index = (int)(g_palloc_map[a >> PALLOC_CHUNK_SHIFT] & PALLOC_MAP_CLASS_MASK) - 1;
+
+    return index;
+}
+
+static PALLOC_FORCEINLINE unsigned int palloc_map_owner( const void * p )
+{
+    uintptr_t a = (uintptr_t)p;
+
+    unsigned int owner = (unsigned int)g_palloc_map[a >> PALLOC_CHUNK_SHIFT] >> PALLOC_MAP_CLASS_BITS;
+
+    return owner;
+}
+
+static PALLOC_FORCEINLINE int palloc_map_zero( const void * p )
+{
+    uintptr_t a = (uintptr_t)p;
+
+    int zero = (g_palloc_map[a >> PALLOC_CHUNK_SHIFT] & PALLOC_MAP_ZERO) != 0;
+
+    return zero;
+}
+
+static void palloc_map_set( const void * p, int index, unsigned int owner, int zero )
+{
+    uintptr_t a = (uintptr_t)p;
+
+    g_palloc_map[a >> PALLOC_CHUNK_SHIFT] = index == -1 ? 0 : PALLOC_MAP_ENTRY(index, owner, zero);
+}
+
+static size_t palloc_map_chunks( int index, palloc_trim_t * chunks, size_t capacity )
+{
+    size_t count = 0;
+
+    for( uintptr_t i = 0; i != sizeof( g_palloc_map ) / sizeof( g_palloc_map[0] ); i += (uintptr_t)1 << PALLOC_CLASS_ORDER( index ) )
+    {
+        if( (g_palloc_map[i] & PALLOC_MAP_CLASS_MASK) != index + 1 )
+        {
+            continue;
+        }
+
+        if( count < capacity )
+        {
+            chunks[count].chunk = i << PALLOC_CHUNK_SHIFT;
+            chunks[count].count = 0;
+        }
+
+        ++count;
+    }
+
+    return count;
+}
+
+static void palloc_map_fini()
+{
+    for( uintptr_t i = 0; i != sizeof( g_palloc_map ) / sizeof( g_palloc_map[0] ); )
+    {
+        if( g_palloc_map[i] == 0 )
+        {
+            ++i;
+
+            continue;
+        }
+
+        unsigned int order = PALLOC_CLASS_ORDER( (g_palloc_map[i] & PALLOC_MAP_CLASS_MASK) - 1 );
+
+        PALLOC_STD_SPAN_FREE( (void *)(i << PALLOC_CHUNK_SHIFT), order );
+
+        for( uintptr_t j = 0; j != (uintptr_t)1 << order; ++j )
+        {
+            g_palloc_map[i++] = 0;
+        }
+    }
+}
+#endif
+
+static palloc_trim_t * palloc_trim_find( palloc_trim_t * chunks, size_t count, const void * p, unsigned int order )
+{
+    uintptr_t c = (uintptr_t)p & ~(uintptr_t)(PALLOC_SPAN_SIZE( order ) - 1);
+
+    size_t lo = 0;
+    size_t hi = count;
+
+    while( lo != hi )
+    {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if( chunks[mid].chunk < c )
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    if( lo == count || chunks[lo].chunk != c )
+    {
+        return NULL;
+    }
+
+    return chunks + lo;
+}
+
+// Every chunk slot of a span is recorded in the chunk map with the class and
+// owner of the span and whether the span came from the backend zero filled.
+static void * palloc_span_alloc( int index, unsigned int owner )
+{
+    unsigned int order = PALLOC_CLASS_ORDER( index );
+
+    int zero;
+    unsigned char * c = (unsigned char *)PALLOC_STD_SPAN_ALLOC_ZERO( order, &zero );
+
+#if defined(PALLOC_THREAD) && defined(PALLOC_MUTEX) && defined(PALLOC_NUMA)
+    if( g_palloc_numa_prefer != 0 )
+    {
+        PALLOC_STD_NUMA_PREFER( c, PALLOC_SPAN_SIZE( order ), (int)(owner >> g_palloc_numa_shift) );
+    }
+#endif
+
+    for( size_t i = 0; i != (size_t)1 << order; ++i )
+    {
+        palloc_map_set( c + (i << PALLOC_CHUNK_SHIFT), index, owner, zero );
+    }
+
+    return c;
+}
+
+static void palloc_span_free( void * p, int index )
+{
+    unsigned int order = PALLOC_CLASS_ORDER( index );
+
+    for( size_t i = 0; i != (size_t)1 << order; ++i )
+    {
+        palloc_map_set( (unsigned char *)p + (i << PALLOC_CHUNK_SHIFT), -1, 0, 0 );
+    }
+
+    PALLOC_STD_SPAN_FREE( p, order );
+}
+
+#if defined(PALLOC_THREAD)
+// Threads run on their own stacks, so the bits above 64 KB of the address of
+// a local tell threads apart without any thread-local state. Shared state
+// that is split into shards is indexed with it.
+static PALLOC_FORCEINLINE unsigned int palloc_thread_hash( unsigned int bits )
+{
+    unsigned char local;
+    unsigned long long a = (unsigned long long)((uintptr_t)&local >> 16);
+
+    unsigned int h = (unsigned int)((a * 0x9e3779b97f4a7c15ULL) >> (64 - bits));
+
+    return h;
+}
+#endif
+
+// PALLOC_MUTEX splits the free list of every class into shards, each with its
+// own lock and bump cursor. A thread allocates from the shard of its hash and
+// only takes blocks from the other shards when its own is empty. It frees the
+// blocks of chunks its shard carved to the shard and all others to the remote
+// list of their owner.
+#if defined(PALLOC_THREAD) && defined(PALLOC_MUTEX)
+static PALLOC_FORCEINLINE unsigned int palloc_shard_index()
+{
+#   if defined(PALLOC_NUMA)
+    unsigned int group = t_palloc_numa_group;
+
+    if( group == PALLOC_NUMA_UNKNOWN )
+    {
+        group = palloc_numa_refresh();
+    }
+
+    unsigned int index = (group << g_palloc_numa_shift) | (palloc_thread_hash( PALLOC_SHARD_BITS ) >> (PALLOC_SHARD_BITS - g_palloc_numa_shift));
+
+    return index;
+#   elif PALLOC_SHARD_BITS == 0
+    return 0;
+#   else
+    unsigned int index = palloc_thread_hash( PALLOC_SHARD_BITS );
+
+    return index;
+#   endif
+}
+#endif
+
+#define PALLOC_TYPE_BLOCK_T(N) palloc_block_##N##_t
+
+#define PALLOC_DECL_BLOCK(N) \
+    typedef union PALLOC_TYPE_BLOCK_T(N) { \
+        unsigned char m[N]; \
+        union PALLOC_TYPE_BLOCK_T(N) * n; \
+    } PALLOC_TYPE_BLOCK_T(N)
+
+#define PALLOC_TYPE_CHUNK_T(N) palloc_chunk_##N##_t
+
+#define PALLOC_DECL_CHUNK(N, K) \
+    typedef struct PALLOC_TYPE_CHUNK_T(N) { \
+        PALLOC_TYPE_BLOCK_T(N) s[K]; \
+    } PALLOC_TYPE_CHUNK_T(N)
+
+// The heads and cursors that threads write to sit on cache lines of their
+// own, so a CAS or a lock on one class or shard never invalidates the line
+// of another.
+#if defined(PALLOC_THREAD) && defined(PALLOC_LOCKFREE)
+typedef struct palloc_atomic_line_t
+{
+    PALLOC_ALIGNAS(PALLOC_CACHE_LINE) PALLOC_STD_ATOMIC64_T value;
+} palloc_atomic_line_t;
+
+#   define PALLOC_NAME_GLOBAL_BLOCK(N) g_palloc_block_##N.value
+
+#   define PALLOC_DECL_GLOBAL_BLOCK(N) \
+        static palloc_atomic_line_t g_palloc_block_##N
+#elif defined(PALLOC_THREAD) && defined(PALLOC_MUTEX)
+#   define PALLOC_TYPE_SHARD_T(N) palloc_shard_##N##_t
+#   define PALLOC_NAME_SHARDS(N) g_palloc_shards_##N
+
+#   define PALLOC_SHARD(N) (PALLOC_NAME_SHARDS(N) + palloc_shard_index())
+
+#   define PALLOC_DECL_GLOBAL_BLOCK(N) \
+        typedef struct PALLOC_TYPE_SHARD_T(N) { \
+            PALLOC_ALIGNAS(PALLOC_CACHE_LINE) PALLOC_STD_MUTEX_T mutex; \
+            PALLOC_TYPE_BLOCK_T(N) * volatile head; \
+            PALLOC_TYPE_BLOCK_T(N) * bump; \
+            PALLOC_TYPE_BLOCK_T(N) * bump_end; \
+            PALLOC_ALIGNAS(PALLOC_CACHE_LINE) PALLOC_STD_ATOMIC64_T remote; \
+        } PALLOC_TYPE_SHARD_T(N); \
+        static PALLOC_TYPE_SHARD_T(N) PALLOC_NAME_SHARDS(N)[PALLOC_SHARD_COUNT]
+#else
+#   define PALLOC_NAME_GLOBAL_BLOCK(N) g_palloc_block_##N
+
+#   define PALLOC_DECL_GLOBAL_BLOCK(N) \
+        static PALLOC_TYPE_BLOCK_T(N) * PALLOC_NAME_GLOBAL_BLOCK(N) = NULL
+#endif
+
+#define PALLOC_NEW_CHUNK(N) _palloc_new_chunk_##N
+
+#define PALLOC_DECL_NEW_CHUNK(I, N) \
+    static PALLOC_TYPE_CHUNK_T(N) * PALLOC_NEW_CHUNK(N)( unsigned int owner ) { \
+        PALLOC_TYPE_CHUNK_T(N) * c = (PALLOC_TYPE_CHUNK_T(N) *)palloc_span_alloc( I, owner ); \
+        return c; \
+    }
+
+#define PALLOC_BUMP(N) _palloc_bump_##N
+
+// Fresh chunks are not threaded into the free list up front. Blocks are
+// carved off a per-class cursor (one per shard with PALLOC_MUTEX) in runs of
+// at most k, and only the run is linked, so a chunk is touched as far as it
+// has been used and the free list only ever holds blocks that were freed.
+#if defined(PALLOC_THREAD) && defined(PALLOC_LOCKFREE)
+#   define PALLOC_NAME_BUMP(N) g_palloc_bump_##N.value
+
+#   define PALLOC_BUMP_RESET(N) PALLOC_NAME_BUMP(N) = 0
+
+#   define PALLOC_DECL_BUMP(I, N, K) \
+        static palloc_atomic_line_t g_palloc_bump_##N; \
+        static PALLOC_TYPE_BLOCK_T(N) * PALLOC_BUMP(N)( unsigned int k, unsigned int * count ) { \
+            unsigned long long h = PALLOC_STD_ATOMIC_LOAD64(&PALLOC_NAME_BUMP(N)); \
+            PALLOC_TYPE_CHUNK_T(N) * c = NULL; \
+            PALLOC_TYPE_BLOCK_T(N) * b; \
+            PALLOC_TYPE_BLOCK_T(N) * e; \
+            for( ;; ) { \
+                if( h == 0 && c == NULL ) { \
+                    c = PALLOC_NEW_CHUNK(N)( 0 ); \
+                } \
+                b = h == 0 ? c->s + 0 : (PALLOC_TYPE_BLOCK_T(N) *)(uintptr_t)h; \
+                PALLOC_TYPE_BLOCK_T(N) * end = ((PALLOC_TYPE_CHUNK_T(N) *)((uintptr_t)b & ~(uintptr_t)(PALLOC_SPAN_SIZE( PALLOC_CLASS_ORDER( I ) ) - 1)))->s + K; \
+                e = (size_t)(end - b) > k ? b + k : end; \
+                if( PALLOC_STD_ATOMIC_COMPARE_EXCHANGE64_WEAK(&PALLOC_NAME_BUMP(N), &h, e == end ? 0 : (unsigned long long)(uintptr_t)e) == 1 ) { \
+                    break; \
+                } \
+            } \
+            if( c != NULL && b != c->s + 0 ) { \
+                palloc_span_free( c, I ); \
+            } \
+            for( PALLOC_TYPE_BLOCK_T(N) * it = b; it + 1 != e; ++it ) { \
+                it->n = it + 1; \
+            } \
+            (e - 1)->n = NULL; \
+            *count = (unsigned int)(e - b); \
+            return b; \
+        }
+#elif defined(PALLOC_THREAD) && defined(PALLOC_MUTEX)
+#   define PALLOC_BUMP_RESET(N) \
+        for( int _s = 0; _s != PALLOC_SHARD_COUNT; ++_s ) { \
+            PALLOC_NAME_SHARDS(N)[_s].bump = NULL; \
+            PALLOC_NAME_SHARDS(N)[_s].bump_end = NULL; \
+        }
+
+// called with the lock of shard s held
+#   define PALLOC_DECL_BUMP(I, N, K) \
+        static PALLOC_TYPE_BLOCK_T(N) * PALLOC_BUMP(N)( PALLOC_TYPE_SHARD_T(N) * s, unsigned int k, unsigned int * count ) { \
+            if( s->bump == s->bump_end ) { \
+                PALLOC_TYPE_CHUNK_T(N) * c = PALLOC_NEW_CHUNK(N)( (unsigned int)(s - PALLOC_NAME_SHARDS(N)) ); \
+                s->bump = c->s + 0; \
+                s->bump_end = c->s + K; \
+            } \
+            PALLOC_TYPE_BLOCK_T(N) * b = s->bump; \
+            PALLOC_TYPE_BLOCK_T(N) * e = (size_t)(s->bump_end - b) > k ? b + k : s->bump_end; \
+            s->bump = e; \
+            for( PALLOC_TYPE_BLOCK_T(N) * it = b; it + 1 != e; ++it ) { \
+                it->n = it + 1; \
+            } \
+            (e - 1)->n = NULL; \
+            *count = (unsigned int)(e - b); \
+            return b; \
+        }
+#else
+#   define PALLOC_NAME_BUMP(N) g_palloc_bump_##N
+#   define PALLOC_NAME_BUMP_END(N) g_palloc_bump_end_##N
+
+#   define PALLOC_BUMP_RESET(N) PALLOC_NAME_BUMP(N) = NULL, PALLOC_NAME_BUMP_END(N) = NULL
+
+#   define PALLOC_DECL_BUMP(I, N, K) \
+        static PALLOC_TYPE_BLOCK_T(N) * PALLOC_NAME_BUMP(N) = NULL; \
+        static PALLOC_TYPE_BLOCK_T(N) * PALLOC_NAME_BUMP_END(N) = NULL; \
+        static PALLOC_TYPE_BLOCK_T(N) * PALLOC_BUMP(N)( unsigned int k, unsigned int * count ) { \
+            if( PALLOC_NAME_BUMP(N) == PALLOC_NAME_BUMP_END(N) ) { \
+                PALLOC_TYPE_CHUNK_T(N) * c = PALLOC_NEW_CHUNK(N)( 0 ); \
+                PALLOC_NAME_BUMP(N) = c->s + 0; \
+                PALLOC_NAME_BUMP_END(N) = c->s + K; \
+            } \
+            PALLOC_TYPE_BLOCK_T(N) * b = PALLOC_NAME_BUMP(N); \
+            PALLOC_TYPE_BLOCK_T(N) * e = (size_t)(PALLOC_NAME_BUMP_END(N) - b) > k ? b + k : PALLOC_NAME_BUMP_END(N); \
+            PALLOC_NAME_BUMP(N) = e; \
+            for( PALLOC_TYPE_BLOCK_T(N) * it = b; it + 1 != e; ++it ) { \
+                it->n = it + 1; \
+            } \
+            (e - 1)->n = NULL; \
+            *count = (unsigned int)(e - b); \
+            return b; \
+        }
+#endif
+
+// A block freed by a thread of another shard than the one owning its chunk is
+// pushed onto the lock-free remote list of the owner. The owner takes the
+// whole list with one atomic operation once its free list runs dry and keeps
+// what it does not need on its free list, so single frees of blocks allocated
+// by another thread never take the lock of the allocating shard. Runs pushed
+// by thread caches and bulk frees already cost one lock per run and stay on
+// the shard of the freeing thread. Taking only the whole list makes the push
+// safe against ABA without a tag.
+#define PALLOC_REMOTE_PUSH(N) _palloc_remote_push_##N
+#define PALLOC_REMOTE_TAKE(N) _palloc_remote_take_##N
+
+#if defined(PALLOC_THREAD) && defined(PALLOC_MUTEX)
+#   define PALLOC_DECL_REMOTE(N) \
+        static PALLOC_FORCEINLINE void PALLOC_REMOTE_PUSH(N)( PALLOC_TYPE_SHARD_T(N) * o, PALLOC_TYPE_BLOCK_T(N) * b, PALLOC_TYPE_BLOCK_T(N) * t ) { \
+            unsigned long long h = PALLOC_STD_ATOMIC_LOAD64(&o->remote); \
+            do { \
+                t->n = (PALLOC_TYPE_BLOCK_T(N) *)(uintptr_t)h; \
+            } while( PALLOC_STD_ATOMIC_COMPARE_EXCHANGE64_WEAK(&o->remote, &h, (unsigned long long)(uintptr_t)b) == 0 ); \
+        } \
+        static PALLOC_TYPE_BLOCK_T(N) * PALLOC_REMOTE_TAKE(N)( PALLOC_TYPE_SHARD_T(N) * o ) { \
+            unsigned long long h = PALLOC_STD_ATOMIC_LOAD64(&o->remote); \
+            while( h != 0 && PALLOC_STD_ATOMIC_COMPARE_EXCHANGE64_WEAK(&o->remote, &h, 0) == 0 ) { \
+            } \
+            return (PALLOC_TYPE_BLOCK_T(N) *)(uintptr_t)h; \
+        }
+#else
+#   define PALLOC_DECL_REMOTE(N)
+#endif
+
+#define PALLOC_PUSH_BATCH(N) _palloc_push_batch_##N
+
+#if defined(PALLOC_THREAD) && defined(PALLOC_LOCKFREE)
+#   define PALLOC_DECL_PUSH_BATCH(N) \
+        static void PALLOC_PUSH_BATCH(N)( PALLOC_TYPE_BLOCK_T(N) * b, PALLOC_TYPE_BLOCK_T(N) * t ) { \
+            unsigned long long h = PALLOC_STD_ATOMIC_LOAD64(&PALLOC_NAME_GLOBAL_BLOCK(N)); \
+            do { \
+                t->n = PALLOC_TAG_PTR(PALLOC_TYPE_BLOCK_T(N), h); \
+            } while( PALLOC_STD_ATOMIC_COMPARE_EXCHANGE64_WEAK(&PALLOC_NAME_GLOBAL_BLOCK(N), &h, PALLOC_TAG_MAKE(h, b)) == 0 ); \
+        }
+#elif defined(PALLOC_THREAD) && defined(PALLOC_MUTEX) && defined(PALLOC_NUMA)
+// Runs from thread caches, bulk frees and ptrim may hold blocks of the chunks
+// of other NUMA groups, those go to the remote lists of their owners and only
+// the rest to shard s.
+#   define PALLOC_DECL_PUSH_BATCH(N) \
+        static void PALLOC_PUSH_BATCH(N)( PALLOC_TYPE_BLOCK_T(N) * b, PALLOC_TYPE_BLOCK_T(N) * t ) { \
+            PALLOC_TYPE_SHARD_T(N) * s = PALLOC_SHARD(N); \
+            if( g_palloc_numa_shift != PALLOC_SHARD_BITS ) { \
+                unsigned int group = (unsigned int)(s - PALLOC_NAME_SHARDS(N)) >> g_palloc_numa_shift; \
+                PALLOC_TYPE_BLOCK_T(N) * l = NULL; \
+                PALLOC_TYPE_BLOCK_T(N) * lt = NULL; \
+                for( PALLOC_TYPE_BLOCK_T(N) * it = b, * it_next; it != NULL; it = it_next ) { \
+                    it_next = it == t ? NULL : it->n; \
+                    unsigned int owner = palloc_map_owner( it ); \
+                    if( (owner >> g_palloc_numa_shift) != group ) { \
+                        PALLOC_REMOTE_PUSH(N)( PALLOC_NAME_SHARDS(N) + owner, it, it ); \
+                        continue; \
+                    } \
+                    if( l == NULL ) { \
+                        l = it; \
+                    } else { \
+                        lt->n = it; \
+                    } \
+                    lt = it; \
+                } \
+                if( l == NULL ) { \
+                    return; \
+                } \
+                b = l; \
+                t = lt; \
+            } \
+            PALLOC_STD_MUTEX_LOCK(&s->mutex); \
+            t->n = s->head; \
+            s->head = b; \
+            PALLOC_STD_MUTEX_UNLOCK(&s->mutex); \
+        }
+#elif defined(PALLOC_THREAD) && defined(PALLOC_MUTEX)
+#   define PALLOC_DECL_PUSH_BATCH(N) \
+        static void PALLOC_PUSH_BATCH(N)( PALLOC_TYPE_BLOCK_T(N) * b, PALLOC_TYPE_BLOCK_T(N) * t ) { \
+            PALLOC_TYPE_SHARD_T(N) * s = PALLOC_SHARD(N); \
+            PALLOC_STD_MUTEX_LOCK(&s->mutex); \
+            t->n = s->head; \
+            s->head = b; \
+            PALLOC_STD_MUTEX_UNLOCK(&s->mutex); \
+        }
+#else
+#   define PALLOC_DECL_PUSH_BATCH(N) \
+        static void PALLOC_PUSH_BATCH(N)( PALLOC_TYPE_BLOCK_T(N) * b, PALLOC_TYPE_BLOCK_T(N) * t ) { \
+            t->n = PALLOC_NAME_GLOBAL_BLOCK(N); \
+            PALLOC_NAME_GLOBAL_BLOCK(N) = b; \
+        }
+#endif
+
+#define PALLOC_DETACH(N) _palloc_detach_##N
+
+#if defined(PALLOC_THREAD) && defined(PALLOC_LOCKFREE)
+#   define PALLOC_DECL_DETACH(N) \
+        static PALLOC_TYPE_BLOCK_T(N) * PALLOC_DETACH(N)() { \
+            unsigned long long h = PALLOC_STD_ATOMIC_LOAD64(&PALLOC_NAME_GLOBAL_BLOCK(N)); \
+            while( PALLOC_STD_ATOMIC_COMPARE_EXCHANGE64_WEAK(&PALLOC_NAME_GLOBAL_BLOCK(N), &h, PALLOC_TAG_MAKE(h, NULL)) == 0 ) { \
+            } \
+            return PALLOC_TAG_PTR(PALLOC_TYPE_BLOCK_T(N), h); \
+        }
+#elif defined(PALLOC_THREAD) && defined(PALLOC_MUTEX)
+#   define PALLOC_DECL_DETACH(N) \
+        static PALLOC_TYPE_BLOCK_T(N) * PALLOC_DETACH(N)() { \
+            PALLOC_TYPE_BLOCK_T(N) * b = NULL; \
+            for( int i = 0; i != PALLOC_SHARD_COUNT; ++i ) { \
+                PALLOC_TYPE_SHARD_T(N) * s = PALLOC_NAME_SHARDS(N) + i; \
+                PALLOC_STD_MUTEX_LOCK(&s->mutex); \
+                PALLOC_TYPE_BLOCK_T(N) * lists[2] = {s->head, NULL}; \
+                s->head = NULL; \
+                PALLOC_STD_MUTEX_UNLOCK(&s->mutex); \
+                lists[1] = PALLOC_REMOTE_TAKE(N)( s ); \
+                for( int j = 0; j != 2; ++j ) { \
+                    PALLOC_TYPE_BLOCK_T(N) * h = lists[j]; \
+                    if( h == NULL ) { \
+                        continue; \
+                    } \
+                    PALLOC_TYPE_BLOCK_T(N) * t = h; \
+                    while( t->n != NULL ) { \
+                        t = t->n; \
+                    } \
+                    t->n = b; \
+                    b = h; \
+                } \
+            } \
+            return b; \
+        }
+#else
+#   define PALLOC_DECL_DETACH(N) \
+        static PALLOC_TYPE_BLOCK_T(N) * PALLOC_DETACH(N)() { \
+            PALLOC_TYPE_BLOCK_T(N) * b = PALLOC_NAME_GLOBAL_BLOCK(N); \
+            PALLOC_NAME_GLOBAL_BLOCK(N) = NULL; \
+            return b; \
+        }
+#endif
+
+// Takes the whole free list of a class, releases the chunks whose K blocks
+// are all on it and pushes the remaining blocks back.
+#define PALLOC_TRIM(N) _palloc_trim_##N
+
+#define PALLOC_DECL_TRIM(I, N, K) \
+    static size_t PALLOC_TRIM(N)() { \
+        PALLOC_TYPE_BLOCK_T(N) * b = PALLOC_DETACH(N)(); \
+        if( b == NULL ) { \
+            return 0; \
+        } \
+        size_t capacity = palloc_map_chunks( I, NULL, 0 ); \
+        palloc_trim_t * chunks = (palloc_trim_t *)PALLOC_STD_MALLOC( capacity * sizeof( palloc_trim_t ) ); \
+        size_t count = chunks == NULL ? 0 : palloc_map_chunks( I, chunks, capacity ); \
+        count = count < capacity ? count : capacity; \
+        for( PALLOC_TYPE_BLOCK_T(N) * it = b; it != NULL; it = it->n ) { \
+            palloc_trim_t * t = palloc_trim_find( chunks, count, it, PALLOC_CLASS_ORDER( I ) ); \
+            if( t != NULL ) { \
+                ++t->count; \
+            } \
+        } \
+        PALLOC_TYPE_BLOCK_T(N) * f = NULL; \
+        PALLOC_TYPE_BLOCK_T(N) * l = NULL; \
+        for( PALLOC_TYPE_BLOCK_T(N) * it = b, * it_next; it != NULL; it = it_next ) { \
+            it_next = it->n; \
+            palloc_trim_t * t = palloc_trim_find( chunks, count, it, PALLOC_CLASS_ORDER( I ) ); \
+            if( t != NULL && t->count == K ) { \
+                continue; \
+            } \
+            it->n = f; \
+            l = f == NULL ? it : l; \
+            f = it; \
+        } \
+        if( f != NULL ) { \
+            PALLOC_PUSH_BATCH(N)( f, l ); \
+        } \
+        size_t nbytes = 0; \
+        for( size_t i = 0; i != count; ++i ) { \
+            if( chunks[i].count == K ) { \
+                palloc_span_free( (void *)chunks[i].chunk, I ); \
+                nbytes += PALLOC_SPAN_SIZE( PALLOC_CLASS_ORDER( I ) ); \
+            } \
+        } \
+        PALLOC_STD_FREE( chunks ); \
+        return nbytes; \
+    }
+
+#define PALLOC_REFILL(N) _palloc_refill_##N
+
+// Pops up to k blocks from shard s, then from the other shards of its NUMA
+// group, and carves fresh blocks in s only when all of them are empty. The
+// group of the thread is refreshed on the way. The remote list of s is
+// reclaimed before its free list runs dry is reported, those of the other
+// shards only before fresh blocks are carved, so no freed block is stranded
+// on a shard whose threads are gone. Reclaimed blocks beyond the first k go to
+// the free list of s. The heads of the other shards are peeked at without
+// their lock so empty shards cost no locking.
+#if defined(PALLOC_THREAD) && defined(PALLOC_MUTEX)
+#   define PALLOC_RECLAIM(N) _palloc_reclaim_##N
+
+#   define PALLOC_DECL_REFILL(N) \
+        static PALLOC_TYPE_BLOCK_T(N) * PALLOC_RECLAIM(N)( PALLOC_TYPE_SHARD_T(N) * s, PALLOC_TYPE_SHARD_T(N) * o, unsigned int k, unsigned int * c ) { \
+            if( PALLOC_STD_ATOMIC_LOAD64(&o->remote) == 0 ) { \
+                return NULL; \
+            } \
+            PALLOC_TYPE_BLOCK_T(N) * b = PALLOC_REMOTE_TAKE(N)( o ); \
+            if( b == NULL ) { \
+                return NULL; \
+            } \
+            PALLOC_TYPE_BLOCK_T(N) * t = b; \
+            unsigned int i; \
+            for( i = 1; i != k && t->n != NULL; ++i ) { \
+                t = t->n; \
+            } \
+            PALLOC_TYPE_BLOCK_T(N) * r = t->n; \
+            t->n = NULL; \
+            *c = i; \
+            if( r != NULL ) { \
+                PALLOC_STD_MUTEX_LOCK(&s->mutex); \
+                if( s->head != NULL ) { \
+                    PALLOC_TYPE_BLOCK_T(N) * l = r; \
+                    while( l->n != NULL ) { \
+                        l = l->n; \
+                    } \
+                    l->n = s->head; \
+                } \
+                s->head = r; \
+                PALLOC_STD_MUTEX_UNLOCK(&s->mutex); \
+            } \
+            return b; \
+        } \
+        static PALLOC_TYPE_BLOCK_T(N) * PALLOC_REFILL(N)( PALLOC_TYPE_SHARD_T(N) * s, unsigned int k, unsigned int * c ) { \
+            PALLOC_NUMA_REFRESH(); \
+            PALLOC_TYPE_BLOCK_T(N) * b; \
+            if( s->head == NULL && (b = PALLOC_RECLAIM(N)( s, s, k, c )) != NULL ) { \
+                return b; \
+            } \
+            unsigned int first = (unsigned int)(s - PALLOC_NAME_SHARDS(N)); \
+            unsigned int group = PALLOC_SHARD_GROUP(); \
+            unsigned int base = first & ~(group - 1); \
+            for( unsigned int j = 0; j != group; ++j ) { \
+                PALLOC_TYPE_SHARD_T(N) * o = PALLOC_NAME_SHARDS(N) + (base | ((first + j) & (group - 1))); \
+                if( o->head == NULL ) { \
+                    continue; \
+                } \
+                PALLOC_STD_MUTEX_LOCK(&o->mutex); \
+                b = o->head; \
+                if( b == NULL ) { \
+                    PALLOC_STD_MUTEX_UNLOCK(&o->mutex); \
+                    continue; \
+                } \
+                PALLOC_TYPE_BLOCK_T(N) * t = b; \
+                unsigned int i; \
+                for( i = 1; i != k && t->n != NULL; ++i ) { \
+                    t = t->n; \
+                } \
+                o->head = t->n; \
+                PALLOC_STD_MUTEX_UNLOCK(&o->mutex); \
+                t->n = NULL; \
+                *c = i; \
+                return b; \
+            } \
+            for( unsigned int j = 1; j != group; ++j ) { \
+                PALLOC_TYPE_SHARD_T(N) * o = PALLOC_NAME_SHARDS(N) + (base | ((first + j) & (group - 1))); \
+                if( (b = PALLOC_RECLAIM(N)( s, o, k, c )) != NULL ) { \
+                    return b; \
+                } \
+            } \
+            PALLOC_STD_MUTEX_LOCK(&s->mutex); \
+            b = PALLOC_BUMP(N)( s, k, c ); \
+            PALLOC_STD_MUTEX_UNLOCK(&s->mutex); \
+            return b; \
+        }
+#else
+#   define PALLOC_DECL_REFILL(N)
+#endif
+
+#define PALLOC_GET_GLOBAL_BLOCK(N) _palloc_get_global_block_##N
+
+#if defined(PALLOC_THREAD) && defined(PALLOC_CACHE)
+#   define PALLOC_DECL_GET_GLOBAL_BLOCK(I, N)
+#elif defined(PALLOC_THREAD) && defined(PALLOC_LOCKFREE)
+#   define PALLOC_DECL_GET_GLOBAL_BLOCK(I, N) \
+        static PALLOC_NOINLINE PALLOC_TYPE_BLOCK_T(N) * PALLOC_GET_GLOBAL_BLOCK(N)() { \
+            PALLOC_STATS_REFILL(I); \
+            unsigned int count; \
+            return PALLOC_BUMP(N)( 1, &count ); \
+        }
+#elif defined(PALLOC_THREAD) && defined(PALLOC_MUTEX)
+#   define PALLOC_DECL_GET_GLOBAL_BLOCK(I, N) \
+        static PALLOC_NOINLINE PALLOC_TYPE_BLOCK_T(N) * PALLOC_GET_GLOBAL_BLOCK(N)( PALLOC_TYPE_SHARD_T(N) * s ) { \
+            PALLOC_STATS_REFILL(I); \
+            unsigned int count; \
+            return PALLOC_REFILL(N)( s, 1, &count ); \
+        }
+#else
+#   define PALLOC_DECL_GET_GLOBAL_BLOCK(I, N) \
+        static PALLOC_NOINLINE PALLOC_TYPE_BLOCK_T(N) * PALLOC_GET_GLOBAL_BLOCK(N)() { \
+            if( PALLOC_NAME_GLOBAL_BLOCK(N) != NULL ) { \
+                return PALLOC_NAME_GLOBAL_BLOCK(N); \
+            } \
+            PALLOC_STATS_REFILL(I); \
+            unsigned int count; \
+            return PALLOC_BUMP(N)( 1, &count ); \
+        }
+#endif
+
+#define PALLOC_POP_BATCH(N) _palloc_pop_batch_##N
+
+// Pops a run of up to k blocks with one atomic operation or lock acquisition
+// and carves fresh blocks when the free list is empty. Thread caches refill
+// with it and palloc_bulk takes its blocks from it.
+#if defined(PALLOC_THREAD) && defined(PALLOC_LOCKFREE)
+#   define PALLOC_DECL_POP_BATCH(I, N) \
+        static PALLOC_NOINLINE PALLOC_TYPE_BLOCK_T(N) * PALLOC_POP_BATCH(N)( unsigned int k, unsigned int * c ) { \
+            PALLOC_STATS_REFILL(I); \
+            unsigned long long h = PALLOC_STD_ATOMIC_LOAD64(&PALLOC_NAME_GLOBAL_BLOCK(N)); \
+            PALLOC_TYPE_BLOCK_T(N) * b; \
+            PALLOC_TYPE_BLOCK_T(N) * t; \
+            unsigned int i; \
+            for( ;; ) { \
+                b = PALLOC_TAG_PTR(PALLOC_TYPE_BLOCK_T(N), h); \
+                if( b == NULL ) { \
+                    return PALLOC_BUMP(N)( k, c ); \
+                } \
+                t = b; \
+                for( i = 1; i != k; ++i ) { \
+                    PALLOC_TYPE_BLOCK_T(N) * n = t->n; \
+                    if( n == NULL || PALLOC_STD_ATOMIC_LOAD64(&PALLOC_NAME_GLOBAL_BLOCK(N)) != h ) { \
+                        break; \
+                    } \
+                    t = n; \
+                } \
+                if( PALLOC_STD_ATOMIC_COMPARE_EXCHANGE64_WEAK(&PALLOC_NAME_GLOBAL_BLOCK(N), &h, PALLOC_TAG_MAKE(h, t->n)) == 1 ) { \
+                    break; \
+                } \
+            } \
+            t->n = NULL; \
+            *c = i; \
+            return b; \
+        }
+#elif defined(PALLOC_THREAD) && defined(PALLOC_MUTEX)
+#   define PALLOC_DECL_POP_BATCH(I, N) \
+        static PALLOC_NOINLINE PALLOC_TYPE_BLOCK_T(N) * PALLOC_POP_BATCH(N)( unsigned int k, unsigned int * c ) { \
+            PALLOC_STATS_REFILL(I); \
+            return PALLOC_REFILL(N)( PALLOC_SHARD(N), k, c ); \
+        }
+#else
+#   define PALLOC_DECL_POP_BATCH(I, N) \
+        static PALLOC_NOINLINE PALLOC_TYPE_BLOCK_T(N) * PALLOC_POP_BATCH(N)( unsigned int k, unsigned int * c ) { \
+            PALLOC_STATS_REFILL(I); \
+            PALLOC_TYPE_BLOCK_T(N) * b = PALLOC_NAME_GLOBAL_BLOCK(N); \
+            if( b == NULL ) { \
+                return PALLOC_BUMP(N)( k, c ); \
+            } \
+            PALLOC_TYPE_BLOCK_T(N) * t = b; \
+            unsigned int i; \
+            for( i = 1; i != k && t->n != NULL; ++i ) { \
+                t = t->n; \
+            } \
+            PALLOC_NAME_GLOBAL_BLOCK(N) = t->n; \
+            t->n = NULL; \
+            *c = i; \
+            return b; \
+        }
+#endif
+
+#if defined(PALLOC_THREAD) && defined(PALLOC_CACHE)
+// Blocks of 16 KB and more are cached one at a time, so a thread keeps at
+// most one idle block of each of those classes.
+#   ifndef PALLOC_CACHE_BATCH
+#       define PALLOC_CACHE_BATCH(N) ((N) <= 64 ? 64 : (N) >= 16384 ? 1 : (4096 / (N) < 4 ? 4 : 4096 / (N)))
+#   endif
+
+#   ifndef PALLOC_CACHE_LIMIT
+#       define PALLOC_CACHE_LIMIT(N) ((N) >= 16384 ? PALLOC_CACHE_BATCH(N) : 2 * PALLOC_CACHE_BATCH(N))
+#   endif
+
+#   define PALLOC_NAME_CACHE_BLOCK(N) t_palloc_cache_block_##N
+#   define PALLOC_NAME_CACHE_COUNT(N) t_palloc_cache_count_##N
+
+#   define PALLOC_DECL_CACHE(I, N) \
+        static PALLOC_STD_TLS PALLOC_TYPE_BLOCK_T(N) * PALLOC_NAME_CACHE_BLOCK(N) = NULL; \
+        static PALLOC_STD_TLS unsigned int PALLOC_NAME_CACHE_COUNT(N) = 0
+
+#   define PALLOC_FLUSH_CACHE(N) _palloc_flush_cache_##N
+
+#   define PALLOC_DECL_FLUSH_CACHE(N) \
+        static void PALLOC_FLUSH_CACHE(N)() { \
+            PALLOC_TYPE_BLOCK_T(N) * b = PALLOC_NAME_CACHE_BLOCK(N); \
+            if( b == NULL ) { \
+                return; \
+            } \
+            PALLOC_TYPE_BLOCK_T(N) * t = b; \
+            while( t->n != NULL ) { \
+                t = t->n; \
+            } \
+            PALLOC_NAME_CACHE_BLOCK(N) = NULL; \
+            PALLOC_NAME_CACHE_COUNT(N) = 0; \
+            PALLOC_PUSH_BATCH(N)( b, t ); \
+        }
+
+static PALLOC_STD_THREAD_KEY_T g_palloc_cache_key;
+static PALLOC_STD_TLS int t_palloc_cache_attached = 0;
+
+static void palloc_cache_attach()
+{
+    if( t_palloc_cache_attached == 1 )
+    {
+        return;
+    }
+
+    t_palloc_cache_attached = 1;
+
+    PALLOC_STD_THREAD_KEY_SET( &g_palloc_cache_key, (void *)&t_palloc_cache_attached );
+}
+#else
+#   define PALLOC_DECL_CACHE(I, N)
+#   define PALLOC_DECL_FLUSH_CACHE(N)
+#endif
+
+#define PALLOC_ALLOC_BLOCK(N) _palloc_alloc_block_##N
+
+#if defined(PALLOC_THREAD) && defined(PALLOC_CACHE)
+#   define PALLOC_DECL_ALLOC_BLOCK(N) \
+        static PALLOC_FORCEINLINE unsigned char * PALLOC_ALLOC_BLOCK(N)() { \
+            PALLOC_TYPE_BLOCK_T(N) * b = PALLOC_NAME_CACHE_BLOCK(N); \
+            if( b == NULL ) { \
+                palloc_cache_attach(); \
+                b = PALLOC_POP_BATCH(N)( PALLOC_CACHE_BATCH(N), &PALLOC_NAME_CACHE_COUNT(N) ); \
+            } \
+            PALLOC_NAME_CACHE_BLOCK(N) = b->n; \
+            --PALLOC_NAME_CACHE_COUNT(N); \
+            unsigned char * m = b->m; \
+            return m; \
+        }
+#elif defined(PALLOC_THREAD) && defined(PALLOC_LOCKFREE)
+#   define PALLOC_DECL_ALLOC_BLOCK(N) \
+        static PALLOC_FORCEINLINE unsigned char * PALLOC_ALLOC_BLOCK(N)() { \
+            unsigned long long h = PALLOC_STD_ATOMIC_LOAD64(&PALLOC_NAME_GLOBAL_BLOCK(N)); \
+            PALLOC_TYPE_BLOCK_T(N) * b; \
+            do { \
+                b = PALLOC_TAG_PTR(PALLOC_TYPE_BLOCK_T(N), h); \
+                if( b == NULL ) { \
+                    b = PALLOC_GET_GLOBAL_BLOCK(N)(); \
+                    break; \
+                } \
+            } while( PALLOC_STD_ATOMIC_COMPARE_EXCHANGE64_WEAK(&PALLOC_NAME_GLOBAL_BLOCK(N), &h, PALLOC_TAG_MAKE(h, b->n)) == 0 ); \
+            unsigned char * m = b->m; \
+            return m; \
+        }
+#elif defined(PALLOC_THREAD) && defined(PALLOC_MUTEX)
+#   define PALLOC_DECL_ALLOC_BLOCK(N) \
+        static PALLOC_FORCEINLINE unsigned char * PALLOC_ALLOC_BLOCK(N)() { \
+            PALLOC_TYPE_SHARD_T(N) * s = PALLOC_SHARD(N); \
+            PALLOC_STD_MUTEX_LOCK(&s->mutex); \
+            PALLOC_TYPE_BLOCK_T(N) * b = s->head; \
+            if( b == NULL ) { \
+                PALLOC_STD_MUTEX_UNLOCK(&s->mutex); \
+                b = PALLOC_GET_GLOBAL_BLOCK(N)( s ); \
+                unsigned char * m = b->m; \
+                return m; \
+            } \
+            s->head = b->n; \
+            PALLOC_STD_MUTEX_UNLOCK(&s->mutex); \
+            unsigned char * m = b->m; \
+            return m; \
+        }
+#else
+#   define PALLOC_DECL_ALLOC_BLOCK(N) \
+        static PALLOC_FORCEINLINE unsigned char * PALLOC_ALLOC_BLOCK(N)() { \
+            PALLOC_TYPE_BLOCK_T(N) * b = PALLOC_NAME_GLOBAL_BLOCK(N); \
+            if( b == NULL ) { \
+                b = PALLOC_GET_GLOBAL_BLOCK(N)(); \
+            } \
+            PALLOC_NAME_GLOBAL_BLOCK(N) = b->n; \
+            unsigned char * m = b->m; \
+            return m; \
+        }
+#endif
+
+#define PALLOC_FREE_BLOCK(N) _palloc_free_block_##N
+
+// Every freed block gets a non-zero second word. A block of a chunk that was
+// zero filled whose second word is still zero has never been handed out and
+// only its link needs clearing for PCALLOC.
+#define PALLOC_MARK_FREE(B) (((void **)(B))[1] = (void *)(B))
+
+#if defined(PALLOC_THREAD) && defined(PALLOC_CACHE)
+#   define PALLOC_DECL_FREE_BLOCK(I, N) \
+        static PALLOC_FORCEINLINE void PALLOC_FREE_BLOCK(N)( void * p ) { \
+            PALLOC_TYPE_BLOCK_T(N) * b = (PALLOC_TYPE_BLOCK_T(N) *)(p); \
+            PALLOC_MARK_FREE(b); \
+            if( PALLOC_NAME_CACHE_BLOCK(N) == NULL ) { \
+                palloc_cache_attach(); \
+            } \
+            b->n = PALLOC_NAME_CACHE_BLOCK(N); \
+            PALLOC_NAME_CACHE_BLOCK(N) = b; \
+            if( ++PALLOC_NAME_CACHE_COUNT(N) <= PALLOC_CACHE_LIMIT(N) ) { \
+                return; \
+            } \
+            PALLOC_TYPE_BLOCK_T(N) * t = b; \
+            for( unsigned int i = 1; i != PALLOC_CACHE_BATCH(N); ++i ) { \
+                t = t->n; \
+            } \
+            PALLOC_NAME_CACHE_BLOCK(N) = t->n; \
+            PALLOC_NAME_CACHE_COUNT(N) -= PALLOC_CACHE_BATCH(N); \
+            PALLOC_PUSH_BATCH(N)( b, t ); \
+            PALLOC_STATS_SPILL(I); \
+        }
+#elif defined(PALLOC_THREAD) && defined(PALLOC_LOCKFREE)
+#   define PALLOC_DECL_FREE_BLOCK(I, N) \
+        static PALLOC_FORCEINLINE void PALLOC_FREE_BLOCK(N)( void * p ) { \
+            PALLOC_TYPE_BLOCK_T(N) * b = (PALLOC_TYPE_BLOCK_T(N) *)(p); \
+            PALLOC_MARK_FREE(b); \
+            PALLOC_PUSH_BATCH(N)( b, b ); \
+        }
+#elif defined(PALLOC_THREAD) && defined(PALLOC_MUTEX)
+#   define PALLOC_DECL_FREE_BLOCK(I, N) \
+        static PALLOC_FORCEINLINE void PALLOC_FREE_BLOCK(N)( void * p ) { \
+            PALLOC_TYPE_BLOCK_T(N) * b = (PALLOC_TYPE_BLOCK_T(N) *)(p); \
+            PALLOC_MARK_FREE(b); \
+            PALLOC_TYPE_SHARD_T(N) * s = PALLOC_SHARD(N); \
+            PALLOC_TYPE_SHARD_T(N) * o = PALLOC_NAME_SHARDS(N) + palloc_map_owner( p ); \
+            if( o != s ) { \
+                PALLOC_REMOTE_PUSH(N)( o, b, b ); \
+                return; \
+            } \
+            PALLOC_STD_MUTEX_LOCK(&s->mutex); \
+            b->n = s->head; \
+            s->head = b; \
+            PALLOC_STD_MUTEX_UNLOCK(&s->mutex); \
+        }
+#else
+#   define PALLOC_DECL_FREE_BLOCK(I, N) \
+        static PALLOC_FORCEINLINE void PALLOC_FREE_BLOCK(N)( void * p ) { \
+            PALLOC_TYPE_BLOCK_T(N) * b = (PALLOC_TYPE_BLOCK_T(N) *)(p); \
+            PALLOC_MARK_FREE(b); \
+            b->n = PALLOC_NAME_GLOBAL_BLOCK(N); \
+            PALLOC_NAME_GLOBAL_BLOCK(N) = b; \
+        }
+#endif
+
+#define PALLOC_ALLOC_BULK(N) _palloc_alloc_bulk_##N
+#define PALLOC_FREE_BULK(N) _palloc_free_bulk_##N
+
+// Bulk allocations take whole runs off the free list with PALLOC_POP_BATCH
+// and bulk frees link their blocks into one run for PALLOC_PUSH_BATCH. With
+// thread caches the cache is used up first and filled up to its limit first.
+#define PALLOC_BULK_RUN (PALLOC_CHUNK_SIZE / PALLOC_ALIGNMENT)
+
+#if defined(PALLOC_THREAD) && defined(PALLOC_CACHE)
+#   define PALLOC_DECL_ALLOC_BULK(N) \
+        static void PALLOC_ALLOC_BULK(N)( void ** out, size_t count ) { \
+            size_t i = 0; \
+            PALLOC_TYPE_BLOCK_T(N) * b = PALLOC_NAME_CACHE_BLOCK(N); \
+            for( ; b != NULL && i != count; b = b->n ) { \
+                out[i++] = b->m; \
+            } \
+            PALLOC_NAME_CACHE_BLOCK(N) = b; \
+            PALLOC_NAME_CACHE_COUNT(N) -= (unsigned int)i; \
+            while( i != count ) { \
+                unsigned int k = count - i < PALLOC_BULK_RUN ? (unsigned int)(count - i) : PALLOC_BULK_RUN; \
+                unsigned int c; \
+                for( b = PALLOC_POP_BATCH(N)( k, &c ); b != NULL; b = b->n ) { \
+                    out[i++] = b->m; \
+                } \
+            } \
+        }
+
+#   define PALLOC_DECL_FREE_BULK(I, N) \
+        static void PALLOC_FREE_BULK(N)( void ** ptrs, size_t count ) { \
+            PALLOC_TYPE_BLOCK_T(N) * b = (PALLOC_TYPE_BLOCK_T(N) *)ptrs[0]; \
+            PALLOC_TYPE_BLOCK_T(N) * t = b; \
+            PALLOC_MARK_FREE(b); \
+            for( size_t i = 1; i != count; ++i ) { \
+                t->n = (PALLOC_TYPE_BLOCK_T(N) *)ptrs[i]; \
+                t = t->n; \
+                PALLOC_MARK_FREE(t); \
+            } \
+            if( count > PALLOC_CACHE_LIMIT(N) ) { \
+                PALLOC_PUSH_BATCH(N)( b, t ); \
+                return; \
+            } \
+            if( PALLOC_NAME_CACHE_BLOCK(N) == NULL ) { \
+                palloc_cache_attach(); \
+            } \
+            t->n = PALLOC_NAME_CACHE_BLOCK(N); \
+            PALLOC_NAME_CACHE_BLOCK(N) = b; \
+            PALLOC_NAME_CACHE_COUNT(N) += (unsigned int)count; \
+            if( PALLOC_NAME_CACHE_COUNT(N) <= PALLOC_CACHE_LIMIT(N) ) { \
+                return; \
+            } \
+            unsigned int spill = PALLOC_NAME_CACHE_COUNT(N) - PALLOC_CACHE_BATCH(N); \
+            t = b; \
+            for( unsigned int i = 1; i != spill; ++i ) { \
+                t = t->n; \
+            } \
+            PALLOC_NAME_CACHE_BLOCK(N) = t->n; \
+            PALLOC_NAME_CACHE_COUNT(N) -= spill; \
+            PALLOC_PUSH_BATCH(N)( b, t ); \
+            PALLOC_STATS_SPILL(I); \
+        }
+#else
+#   define PALLOC_DECL_ALLOC_BULK(N) \
+        static void PALLOC_ALLOC_BULK(N)( void ** out, size_t count ) { \
+            size_t i = 0; \
+            while( i != count ) { \
+                unsigned int k = count - i < PALLOC_BULK_RUN ? (unsigned int)(count - i) : PALLOC_BULK_RUN; \
+                unsigned int c; \
+                for( PALLOC_TYPE_BLOCK_T(N) * b = PALLOC_POP_BATCH(N)( k, &c ); b != NULL; b = b->n ) { \
+                    out[i++] = b->m; \
+                } \
+            } \
+        }
+
+#   define PALLOC_DECL_FREE_BULK(I, N) \
+        static void PALLOC_FREE_BULK(N)( void ** ptrs, size_t count ) { \
+            PALLOC_TYPE_BLOCK_T(N) * b = (PALLOC_TYPE_BLOCK_T(N) *)ptrs[0]; \
+            PALLOC_TYPE_BLOCK_T(N) * t = b; \
+            PALLOC_MARK_FREE(b); \
+            for( size_t i = 1; i != count; ++i ) { \
+                t->n = (PALLOC_TYPE_BLOCK_T(N) *)ptrs[i]; \
+                t = t->n; \
+                PALLOC_MARK_FREE(t); \
+            } \
+            PALLOC_PUSH_BATCH(N)( b, t ); \
+        }
+#endif
+
+#define PALLOC_DECLARE(I, N, K) \
+    PALLOC_DECL_BLOCK(N); \
+    PALLOC_DECL_CHUNK(N, K); \
+    PALLOC_DECL_GLOBAL_BLOCK(N); \
+    PALLOC_DECL_NEW_CHUNK(I, N); \
+    PALLOC_DECL_BUMP(I, N, K); \
+    PALLOC_DECL_REMOTE(N); \
+    PALLOC_DECL_PUSH_BATCH(N); \
+    PALLOC_DECL_REFILL(N); \
+    PALLOC_DECL_POP_BATCH(I, N); \
+    PALLOC_DECL_GET_GLOBAL_BLOCK(I, N); \
+    PALLOC_DECL_CACHE(I, N); \
+    PALLOC_DECL_ALLOC_BLOCK(N); \
+    PALLOC_DECL_FREE_BLOCK(I, N); \
+    PALLOC_DECL_ALLOC_BULK(N); \
+    PALLOC_DECL_FREE_BULK(I, N); \
+    PALLOC_DECL_FLUSH_CACHE(N); \
+    PALLOC_DECL_DETACH(N); \
+    PALLOC_DECL_TRIM(I, N, K)
+
+// PALLOC_STATS counts allocations per class. The counters are spread over
+// shards picked by palloc_thread_hash, so threads mostly increment their own
+// cache lines; a snapshot sums the shards.
+#if defined(PALLOC_STATS)
+#   include <stdarg.h>
+
+typedef char palloc_check_stats_class_count[PSTATS_CLASS_COUNT == PALLOC_CLASS_COUNT ? 1 : -1];
+
+#   if defined(PALLOC_THREAD)
+#       ifndef PALLOC_STATS_SHARD_BITS
+#           define PALLOC_STATS_SHARD_BITS 4
+#       endif
+
+#       define PALLOC_STATS_COUNTER_T PALLOC_STD_COUNTER_T
+#       define PALLOC_STATS_ADD(C, V) PALLOC_STD_COUNTER_ADD( &(C), (unsigned long long)(V) )
+#       define PALLOC_STATS_LOAD(C) PALLOC_STD_COUNTER_LOAD( &(C) )
+#   else
+#       define PALLOC_STATS_SHARD_BITS 0
+
+#       define PALLOC_STATS_COUNTER_T unsigned long long
+#       define PALLOC_STATS_ADD(C, V) ((C) += (unsigned long long)(V))
+#       define PALLOC_STATS_LOAD(C) (C)
+#   endif
+
+#   define PALLOC_STATS_SHARD_COUNT (1 << PALLOC_STATS_SHARD_BITS)
+
+typedef struct palloc_stats_class_t
+{
+    PALLOC_STATS_COUNTER_T allocs;
+    PALLOC_STATS_COUNTER_T frees;
+    PALLOC_STATS_COUNTER_T refills;
+    PALLOC_STATS_COUNTER_T requested;
+} palloc_stats_class_t;
+
+// large_bytes wraps around in a shard that frees more than it allocated,
+// the sum over all shards is exact
+typedef struct palloc_stats_shard_t
+{
+    PALLOC_ALIGNAS(PALLOC_CACHE_LINE) palloc_stats_class_t classes[PALLOC_CLASS_COUNT];
+
+    PALLOC_STATS_COUNTER_T large_allocs;
+    PALLOC_STATS_COUNTER_T large_frees;
+    PALLOC_STATS_COUNTER_T large_bytes;
+
+    unsigned char padding[PALLOC_CACHE_LINE - (PALLOC_CLASS_COUNT * sizeof( palloc_stats_class_t ) + 3 * sizeof( PALLOC_STATS_COUNTER_T )) % PALLOC_CACHE_LINE];
+} palloc_stats_shard_t;
+
+static palloc_stats_shard_t g_palloc_stats[PALLOC_STATS_SHARD_COUNT];
+
+static PALLOC_FORCEINLINE palloc_stats_shard_t * palloc_stats_shard()
+{
+#   if PALLOC_STATS_SHARD_BITS == 0
+    return g_palloc_stats;
+#   else
+    unsigned int shard = palloc_thread_hash( PALLOC_STATS_SHARD_BITS );
+
+    return g_palloc_stats + shard;
+#   endif
+}
+
+// With thread caches the per-call counters stay in the thread and are added
+// to its shard whenever the cache of the class refills or spills, and for
+// every class when the thread detaches or takes a snapshot.
+#   if defined(PALLOC_THREAD) && defined(PALLOC_CACHE)
+typedef struct palloc_stats_local_t
+{
+    unsigned long long allocs;
+    unsigned long long frees;
+    unsigned long long requested;
+} palloc_stats_local_t;
+
+static PALLOC_STD_TLS palloc_stats_local_t t_palloc_stats[PALLOC_CLASS_COUNT];
+
+static void palloc_stats_publish( int index )
+{
+    palloc_stats_local_t * l = t_palloc_stats + index;
+    palloc_stats_class_t * s = palloc_stats_shard()->classes + index;
+
+    PALLOC_STATS_ADD( s->allocs, l->allocs );
+    PALLOC_STATS_ADD( s->frees, l->frees );
+    PALLOC_STATS_ADD( s->requested, l->requested );
+
+    l->allocs = 0;
+    l->frees = 0;
+    l->requested = 0;
+}
+
+static void palloc_stats_publish_all()
+{
+    for( int i = 0; i != PALLOC_CLASS_COUNT; ++i )
+    {
+        palloc_stats_publish( i );
+    }
+}
+
+#       define PALLOC_STATS_ALLOC_BULK(I, C, NB) do { \
+            palloc_stats_local_t * _l = t_palloc_stats + (I); \
+            _l->allocs += (C); \
+            _l->requested += (NB); \
+        } while( 0 )
+
+#       define PALLOC_STATS_FREE_BULK(I, C) (t_palloc_stats[I].frees += (C))
+
+#       define PALLOC_STATS_REFILL(I) do { \
+            palloc_stats_publish( I ); \
+            PALLOC_STATS_ADD( palloc_stats_shard()->classes[I].refills, 1 ); \
+        } while( 0 )
+
+#       define PALLOC_STATS_SPILL(I) palloc_stats_publish( I )
+#   else
+#       define PALLOC_STATS_ALLOC_BULK(I, C, NB) do { \
+            palloc_stats_class_t * _s = palloc_stats_shard()->classes + (I); \
+            PALLOC_STATS_ADD( _s->allocs, C ); \
+            PALLOC_STATS_ADD( _s->requested, NB ); \
+        } while( 0 )
+
+#       define PALLOC_STATS_FREE_BULK(I, C) PALLOC_STATS_ADD( palloc_stats_shard()->classes[I].frees, C )
+#       define PALLOC_STATS_REFILL(I) PALLOC_STATS_ADD( palloc_stats_shard()->classes[I].refills, 1 )
+#       define PALLOC_STATS_SPILL(I) do {} while( 0 )
+#   endif
+
+#   define PALLOC_STATS_LARGE_ALLOC(NB) do { \
+        palloc_stats_shard_t * _s = palloc_stats_shard(); \
+        PALLOC_STATS_ADD( _s->large_allocs, 1 ); \
+        PALLOC_STATS_ADD( _s->large_bytes, NB ); \
+    } while( 0 )
+
+#   define PALLOC_STATS_LARGE_FREE(NB) do { \
+        palloc_stats_shard_t * _s = palloc_stats_shard(); \
+        PALLOC_STATS_ADD( _s->large_frees, 1 ); \
+        PALLOC_STATS_ADD( _s->large_bytes, 0 - (unsigned long long)(NB) ); \
+    } while( 0 )
+
+#   define PALLOC_STATS_LARGE_RESIZE(OLD, NEW) PALLOC_STATS_ADD( palloc_stats_shard()->large_bytes, (unsigned long long)(NEW) - (unsigned long long)(OLD) )
+
+#   define PALLOC_STATS_ALLOC(I, NB) PALLOC_STATS_ALLOC_BULK(I, 1, NB)
+#   define PALLOC_STATS_FREE(I) PALLOC_STATS_FREE_BULK(I, 1)
+#else
+#   define PALLOC_STATS_ALLOC(I, NB) do {} while( 0 )
+#   define PALLOC_STATS_FREE(I) do {} while( 0 )
+#   define PALLOC_STATS_ALLOC_BULK(I, C, NB) do {} while( 0 )
+#   define PALLOC_STATS_FREE_BULK(I, C) do {} while( 0 )
+#   define PALLOC_STATS_REFILL(I) do {} while( 0 )
+#   define PALLOC_STATS_SPILL(I) do {} while( 0 )
+#   define PALLOC_STATS_LARGE_ALLOC(NB) do {} while( 0 )
+#   define PALLOC_STATS_LARGE_FREE(NB) do {} while( 0 )
+#   define PALLOC_STATS_LARGE_RESIZE(OLD, NEW) do {} while( 0 )
+#endif
+
+#define PALLOC_DECLARE_CLASS(I, N) \
+    typedef char palloc_check_class_##N[PALLOC_CLASS_SIZE(I) == (N) && (I) < PALLOC_CLASS_COUNT ? 1 : -1]; \
+    PALLOC_DECLARE(I, N, PALLOC_SPAN_SIZE( PALLOC_CLASS_ORDER( I ) ) / (N));
+
+PALLOC_CLASSES( PALLOC_DECLARE_CLASS )
+
+typedef char palloc_check_class_count[PALLOC_CLASS_SIZE( PALLOC_CLASS_COUNT - 1 ) == PALLOC_THRESHOLD ? 1 : -1];
+
+// Dispatch on the class index with a switch rather than a table of function
+// pointers so each per-class fast path is inlined into its caller and the
+// compiler only has to emit one indirect jump.
+#define PALLOC_ALLOC_CASE_ENTRY(I, N) case I: return PALLOC_ALLOC_BLOCK(N)();
+
+static PALLOC_FORCEINLINE unsigned char * palloc_alloc_class( int index )
+{
+    switch( index )
+    {
+    PALLOC_CLASSES( PALLOC_ALLOC_CASE_ENTRY )
+    }
+
+    return NULL;
+}
+
+#define PALLOC_FREE_CASE_ENTRY(I, N) case I: PALLOC_FREE_BLOCK(N)( p ); return;
+
+static PALLOC_FORCEINLINE void palloc_free_class( int index, void * p )
+{
+    switch( index )
+    {
+    PALLOC_CLASSES( PALLOC_FREE_CASE_ENTRY )
+    }
+}
+
+#define PALLOC_ALLOC_BULK_CASE_ENTRY(I, N) case I: PALLOC_ALLOC_BULK(N)( out, count ); return;
+
+static void palloc_alloc_bulk_class( int index, void ** out, size_t count )
+{
+    switch( index )
+    {
+    PALLOC_CLASSES( PALLOC_ALLOC_BULK_CASE_ENTRY )
+    }
+}
+
+#define PALLOC_FREE_BULK_CASE_ENTRY(I, N) case I: PALLOC_FREE_BULK(N)( ptrs, count ); return;
+
+static void palloc_free_bulk_class( int index, void ** ptrs, size_t count )
+{
+    switch( index )
+    {
+    PALLOC_CLASSES( PALLOC_FREE_BULK_CASE_ENTRY )
+    }
+}
+
+#define PALLOC_SIZE_TABLE_ENTRY(I, N) N,
+
+static const size_t palloc_size_table[PALLOC_CLASS_COUNT] = {
+    PALLOC_CLASSES( PALLOC_SIZE_TABLE_ENTRY )
+};
+
+static unsigned int palloc_log2( size_t x )
+{
+#if defined(_MSC_VER)
+    unsigned long i;
+    _BitScanReverse( &i, (unsigned long)x );
+
+    return (unsigned int)i;
+#elif defined(__GNUC__) || defined(__clang__)
+    unsigned int i = 31 - __builtin_clz( (unsigned int)x );
+
+    return i;
+#else
+    unsigned int i = 0;
+    while( x >>= 1 )
+    {
+        ++i;
+    }
+
+    return i;
+#endif
+}
+
+static PALLOC_FORCEINLINE int palloc_index( size_t nbytes )
+{
+    size_t n = nbytes - 1;
+
+    if( n < 64 )
+    {
+        int index = (int)(n >> 4);
+
+        return index;
+    }
+
+    unsigned int lg = palloc_log2( n );
+
+    int index = (int)(4 * lg - 24 + (n >> (lg - 2)));
+
+    return index;
+}
+
+#define PALLOC_INDEX(N) palloc_index(N)
+#define PALLOC_ALLOC(I) palloc_alloc_class(I)
+#define PALLOC_FREE(I, Q) palloc_free_class(I, Q)
+
+// Large blocks carry their size and the distance back to the start of the
+// underlying allocation. The low bit of the offset marks a block mapped
+// straight from the system, whose size is its whole page-rounded capacity.
+typedef struct palloc_large_t
+{
+    size_t nbytes;
+    size_t offset;
+} palloc_large_t;
+
+#define PALLOC_LARGE_MAPPED 1
+
+// growing a block grows it by at least half, so buffers appended to a few
+// bytes at a time only move a logarithmic number of times; the growth
+// saturates instead of wrapping
+static size_t palloc_grow_nbytes( size_t old_nbytes, size_t nbytes )
+{
+    size_t grow_nbytes = old_nbytes > SIZE_MAX - old_nbytes / 2 ? SIZE_MAX : old_nbytes + old_nbytes / 2;
+
+    if( nbytes > old_nbytes && nbytes < grow_nbytes )
+    {
+        return grow_nbytes;
+    }
+
+    return nbytes;
+}
+
+static unsigned char * palloc_large_align( unsigned char * q, size_t alignment )
+{
+    unsigned char * p = (unsigned char *)(((uintptr_t)q + PALLOC_ALIGNMENT + alignment - 1) & ~(uintptr_t)(alignment - 1));
+
+    return p;
+}
+
+static unsigned char * palloc_large_qp( unsigned char * q, size_t nbytes, size_t alignment )
+{
+    unsigned char * p = palloc_large_align( q, alignment );
+
+    palloc_large_t * h = (palloc_large_t *)p - 1;
+    h->nbytes = nbytes;
+    h->offset = (size_t)(p - q);
+
+    return p;
+}
+
+static unsigned char * palloc_large_pq( unsigned char * p, size_t * const nbytes )
+{
+    const palloc_large_t * h = (const palloc_large_t *)p - 1;
+
+    *nbytes = h->nbytes;
+
+    unsigned char * q = p - (h->offset & ~(size_t)PALLOC_LARGE_MAPPED);
+
+    return q;
+}
+
+#if defined(PALLOC_PAGES)
+#   ifndef PALLOC_PAGES_MAP_THRESHOLD
+#       define PALLOC_PAGES_MAP_THRESHOLD (128 << 10)
+#   endif
+
+static size_t palloc_large_map_size( size_t nbytes )
+{
+    size_t size = (nbytes + PALLOC_ALIGNMENT + PALLOC_PAGES_PAGE_SIZE - 1) & ~(size_t)(PALLOC_PAGES_PAGE_SIZE - 1);
+
+    return size;
+}
+
+static unsigned char * palloc_large_map_qp( unsigned char * q, size_t size )
+{
+    unsigned char * p = q + PALLOC_ALIGNMENT;
+
+    palloc_large_t * h = (palloc_large_t *)p - 1;
+    h->nbytes = size - PALLOC_ALIGNMENT;
+    h->offset = PALLOC_ALIGNMENT | PALLOC_LARGE_MAPPED;
+
+    return p;
+}
+
+static int palloc_large_mapped( const void * p )
+{
+    const palloc_large_t * h = (const palloc_large_t *)p - 1;
+
+    int mapped = (h->offset & PALLOC_LARGE_MAPPED) != 0;
+
+    return mapped;
+}
+
+static void * palloc_large_map( size_t nbytes )
+{
+    if( nbytes > SIZE_MAX - PALLOC_ALIGNMENT - PALLOC_PAGES_PAGE_SIZE )
+    {
+        return NULL;
+    }
+
+    size_t size = palloc_large_map_size( nbytes );
+
+    unsigned char * q = (unsigned char *)PALLOC_STD_PAGES_MAP( size );
+
+    if( q == NULL )
+    {
+        return NULL;
+    }
+
+    unsigned char * p = palloc_large_map_qp( q, size );
+
+    return p;
+}
+
+// Alignments above the threshold map the padding with the block and hand
+// the pages of it back, keeping one page in front of the block for the
+// header. Windows releases a mapping only as a whole and keeps the padding.
+static void * palloc_large_map_aligned( size_t nbytes, size_t alignment )
+{
+    if( nbytes > SIZE_MAX - alignment - PALLOC_PAGES_PAGE_SIZE )
+    {
+        return NULL;
+    }
+
+    size_t size = (nbytes + PALLOC_PAGES_PAGE_SIZE - 1) & ~(size_t)(PALLOC_PAGES_PAGE_SIZE - 1);
+
+    unsigned char * m = (unsigned char *)PALLOC_STD_PAGES_MAP( size + alignment );
+
+    if( m == NULL )
+    {
+        return NULL;
+    }
+
+    unsigned char * p = (unsigned char *)(((uintptr_t)m + PALLOC_PAGES_PAGE_SIZE + alignment - 1) & ~(uintptr_t)(alignment - 1));
+
+#   if defined(_MSC_VER)
+    unsigned char * q = m;
+    unsigned char * e = m + size + alignment;
+#   else
+    unsigned char * q = p - PALLOC_PAGES_PAGE_SIZE;
+    unsigned char * e = p + size;
+
+    if( q != m )
+    {
+        PALLOC_STD_PAGES_RELEASE( m, (size_t)(q - m) );
+    }
+
+    if( e != m + size + alignment )
+    {
+        PALLOC_STD_PAGES_RELEASE( e, (size_t)(m + size + alignment - e) );
+    }
+#   endif
+
+    palloc_large_t * h = (palloc_large_t *)p - 1;
+    h->nbytes = (size_t)(e - p);
+    h->offset = (size_t)(p - q) | PALLOC_LARGE_MAPPED;
+
+    return p;
+}
+
+static void * palloc_large_map_realloc( void * p, size_t nbytes )
+{
+    size_t old_nbytes;
+    unsigned char * old_q = palloc_large_pq( p, &old_nbytes );
+
+    size_t old_offset = (size_t)((unsigned char *)p - old_q);
+
+    if( nbytes <= old_nbytes && nbytes >= old_nbytes / 2 )
+    {
+        return p;
+    }
+
+    size_t grow_nbytes = palloc_grow_nbytes( old_nbytes, nbytes );
+
+    if( grow_nbytes > SIZE_MAX - PALLOC_ALIGNMENT - PALLOC_PAGES_PAGE_SIZE )
+    {
+        return NULL;
+    }
+
+    size_t old_size = old_nbytes + old_offset;
+    size_t new_size = palloc_large_map_size( grow_nbytes );
+
+    // the pages of an aligned block sit further into the mapping than the
+    // new block will, so only blocks at the usual offset move by remapping
+    unsigned char * new_q = NULL;
+
+    if( old_offset == PALLOC_ALIGNMENT )
+    {
+        new_q = (unsigned char *)PALLOC_STD_PAGES_REMAP( old_q, old_size, new_size );
+    }
+
+    if( new_q == NULL )
+    {
+        new_q = (unsigned char *)PALLOC_STD_PAGES_MAP( new_size );
+
+        if( new_q == NULL )
+        {
+            return NULL;
+        }
+
+        size_t min_nbytes = old_nbytes < nbytes ? old_nbytes : nbytes;
+        PALLOC_STD_MEMCPY( new_q + PALLOC_ALIGNMENT, p, min_nbytes );
+
+        PALLOC_STD_PAGES_RELEASE( old_q, old_size );
+    }
+
+    unsigned char * new_p = palloc_large_map_qp( new_q, new_size );
+
+    PALLOC_STATS_LARGE_RESIZE( old_nbytes, new_size - PALLOC_ALIGNMENT );
+
+    return new_p;
+}
+#endif
+
+static void * palloc_large_alloc( size_t nbytes, size_t alignment )
+{
+    // the header and the alignment padding must not wrap the size
+    if( nbytes > SIZE_MAX - PALLOC_ALIGNMENT - alignment )
+    {
+        return NULL;
+    }
+
+#if defined(PALLOC_PAGES)
+    if( nbytes >= PALLOC_PAGES_MAP_THRESHOLD && alignment <= PALLOC_ALIGNMENT )
+    {
+        void * p = palloc_large_map( nbytes );
+
+        if( p != NULL )
+        {
+            PALLOC_STATS_LARGE_ALLOC( palloc_large_map_size( nbytes ) - PALLOC_ALIGNMENT );
+        }
+
+        return p;
+    }
+
+    if( alignment > PALLOC_THRESHOLD )
+    {
+        unsigned char * p = (unsigned char *)palloc_large_map_aligned( nbytes, alignment );
+
+        if( p != NULL )
+        {
+            PALLOC_STATS_LARGE_ALLOC( ((palloc_large_t *)p - 1)->nbytes );
+        }
+
+        return p;
+    }
+#endif
+
+    unsigned char * q = (unsigned char *)PALLOC_STD_MALLOC( nbytes + PALLOC_ALIGNMENT + alignment );
+
+    if( q == NULL )
+    {
+        return NULL;
+    }
+
+    unsigned char * p = palloc_large_qp( q, nbytes, alignment );
+
+    PALLOC_STATS_LARGE_ALLOC( nbytes );
+
+    return p;
+}
+
+// Fresh mappings read as zero and the C library's calloc skips clearing the
+// memory it maps itself.
+static void * palloc_large_calloc( size_t nbytes )
+{
+#if defined(PALLOC_PAGES)
+    if( nbytes >= PALLOC_PAGES_MAP_THRESHOLD )
+    {
+        void * p = palloc_large_alloc( nbytes, PALLOC_ALIGNMENT );
+
+        return p;
+    }
+#endif
+
+#if defined(PALLOC_STD_CALLOC)
+    if( nbytes > SIZE_MAX - 2 * PALLOC_ALIGNMENT )
+    {
+        return NULL;
+    }
+
+    unsigned char * q = (unsigned char *)PALLOC_STD_CALLOC( 1, nbytes + 2 * PALLOC_ALIGNMENT );
+
+    if( q == NULL )
+    {
+        return NULL;
+    }
+
+    unsigned char * p = palloc_large_qp( q, nbytes, PALLOC_ALIGNMENT );
+
+    PALLOC_STATS_LARGE_ALLOC( nbytes );
+#else
+    unsigned char * p = (unsigned char *)palloc_large_alloc( nbytes, PALLOC_ALIGNMENT );
+
+    if( p == NULL )
+    {
+        return NULL;
+    }
+
+    PALLOC_STD_MEMSET( p, 0, nbytes );
+#endif
+
+    return p;
+}
+
+static void palloc_large_free( void * p )
+{
+    size_t nbytes;
+    unsigned char * q = palloc_large_pq( p, &nbytes );
+
+    PALLOC_STATS_LARGE_FREE( nbytes );
+
+#if defined(PALLOC_PAGES)
+    if( palloc_large_mapped( p ) )
+    {
+        PALLOC_STD_PAGES_RELEASE( q, nbytes + (size_t)((unsigned char *)p - q) );
+
+        return;
+    }
+#endif
+
+    PALLOC_STD_FREE( q );
+}
+
+static void * palloc_large_realloc( void * p, size_t nbytes )
+{
+#if defined(PALLOC_PAGES)
+    if( palloc_large_mapped( p ) )
+    {
+        void * new_p = palloc_large_map_realloc( p, nbytes );
+
+        return new_p;
+    }
+#endif
+
+    size_t old_nbytes;
+    unsigned char * old_q = palloc_large_pq( p, &old_nbytes );
+
+    if( nbytes <= old_nbytes && nbytes >= old_nbytes / 2 )
+    {
+        return p;
+    }
+
+    nbytes = palloc_grow_nbytes( old_nbytes, nbytes );
+
+    size_t old_offset = (size_t)((unsigned char *)p - old_q);
+
+    size_t padding = old_offset > 2 * PALLOC_ALIGNMENT ? old_offset : 2 * PALLOC_ALIGNMENT;
+
+    if( nbytes > SIZE_MAX - padding )
+    {
+        return NULL;
+    }
+
+    unsigned char * new_q = (unsigned char *)PALLOC_STD_REALLOC( old_q, nbytes + padding );
+
+    if( new_q == NULL )
+    {
+        return NULL;
+    }
+
+    unsigned char * new_p = palloc_large_align( new_q, PALLOC_ALIGNMENT );
+
+    if( (size_t)(new_p - new_q) != old_offset )
+    {
+        size_t min_nbytes = old_nbytes < nbytes ? old_nbytes : nbytes;
+        PALLOC_STD_MEMMOVE( new_p, new_q + old_offset, min_nbytes );
+    }
+
+    palloc_large_qp( new_q, nbytes, PALLOC_ALIGNMENT );
+
+    PALLOC_STATS_LARGE_RESIZE( old_nbytes, nbytes );
+
+    return new_p;
+}
+
+#if defined(PALLOC_THREAD) && defined(PALLOC_CACHE)
+#define PALLOC_FLUSH_CACHE_ENTRY(I, N) PALLOC_FLUSH_CACHE(N)();
+
+static void palloc_cache_flush()
+{
+    PALLOC_CLASSES( PALLOC_FLUSH_CACHE_ENTRY )
+}
+
+static void PALLOC_STD_THREAD_KEY_CALLBACK palloc_cache_detach( void * ud )
+{
+    (void)ud;
+
+    palloc_cache_flush();
+
+#   if defined(PALLOC_STATS)
+    palloc_stats_publish_all();
+#   endif
+
+    t_palloc_cache_attached = 0;
+}
+#endif
+
+#define PALLOC_TRIM_ENTRY(I, N) nbytes += PALLOC_TRIM(N)();
+#define PALLOC_DETACH_ENTRY(I, N) PALLOC_DETACH(N)(); PALLOC_BUMP_RESET(N);
+
+#if defined(PALLOC_THREAD) && defined(PALLOC_MUTEX)
+#   define PALLOC_MUTEX_INIT_ENTRY(I, N) \
+        for( int s = 0; s != PALLOC_SHARD_COUNT; ++s ) { \
+            PALLOC_STD_MUTEX_INIT( &PALLOC_NAME_SHARDS(N)[s].mutex ); \
+        }
+
+#   define PALLOC_MUTEX_FINI_ENTRY(I, N) \
+        for( int s = 0; s != PALLOC_SHARD_COUNT; ++s ) { \
+            PALLOC_STD_MUTEX_FINI( &PALLOC_NAME_SHARDS(N)[s].mutex ); \
+        }
+
+#   define PALLOC_MUTEX_LOCK_ENTRY(I, N) \
+        for( int s = 0; s != PALLOC_SHARD_COUNT; ++s ) { \
+            PALLOC_STD_MUTEX_LOCK( &PALLOC_NAME_SHARDS(N)[s].mutex ); \
+        }
+
+#   define PALLOC_MUTEX_UNLOCK_ENTRY(I, N) \
+        for( int s = 0; s != PALLOC_SHARD_COUNT; ++s ) { \
+            PALLOC_STD_MUTEX_UNLOCK( &PALLOC_NAME_SHARDS(N)[s].mutex ); \
+        }
+#endif
+
+void PINIT()
+{
+#if defined(PALLOC_THREAD) && defined(PALLOC_MUTEX)
+#   if UINTPTR_MAX > 0xffffffffu
+    PALLOC_STD_MUTEX_INIT( &g_palloc_map_mutex );
+#   endif
+
+#   if defined(PALLOC_PAGES)
+    PALLOC_STD_MUTEX_INIT( &g_palloc_pages_mutex );
+#   endif
+
+    PALLOC_CLASSES( PALLOC_MUTEX_INIT_ENTRY )
+#endif
+
+#if defined(PALLOC_THREAD) && defined(PALLOC_CACHE)
+    PALLOC_STD_THREAD_KEY_INIT( &g_palloc_cache_key, &palloc_cache_detach );
+#endif
+
+#if defined(PALLOC_THREAD) && defined(PALLOC_MUTEX) && defined(PALLOC_NUMA)
+    palloc_numa_init();
+#endif
+}
+
+void PFINI()
+{
+#if defined(PALLOC_THREAD) && defined(PALLOC_CACHE)
+    palloc_cache_detach( NULL );
+
+    PALLOC_STD_THREAD_KEY_FINI( &g_palloc_cache_key );
+#endif
+
+    PALLOC_CLASSES( PALLOC_DETACH_ENTRY )
+
+    palloc_map_fini();
+
+#if defined(PALLOC_PAGES)
+    palloc_pages_fini();
+#endif
+
+#if defined(PALLOC_STATS)
+    PALLOC_STD_MEMSET( (void *)g_palloc_stats, 0, sizeof( g_palloc_stats ) );
+#endif
+
+#if defined(PALLOC_THREAD) && defined(PALLOC_MUTEX)
+#   if UINTPTR_MAX > 0xffffffffu
+    PALLOC_STD_MUTEX_FINI( &g_palloc_map_mutex );
+#   endif
+
+#   if defined(PALLOC_PAGES)
+    PALLOC_STD_MUTEX_FINI( &g_palloc_pages_mutex );
+#   endif
+
+    PALLOC_CLASSES( PALLOC_MUTEX_FINI_ENTRY )
+#endif
+}
+
+// Locks are taken in the order the allocator nests them, the shards, then
+// the page backend, then the chunk map, so a fork cannot happen while another
+// thread holds one of them. The child is left with only the forking thread
+// and sets the mutexes up again instead of unlocking them.
+void PFORK_PREPARE()
+{
+#if defined(PALLOC_THREAD) && defined(PALLOC_MUTEX)
+    PALLOC_CLASSES( PALLOC_MUTEX_LOCK_ENTRY )
+#endif
+
+#if defined(PALLOC_THREAD) && defined(PALLOC_PAGES)
+    palloc_pages_lock();
+#endif
+
+#if defined(PALLOC_THREAD) && defined(PALLOC_MUTEX) && UINTPTR_MAX > 0xffffffffu
+    PALLOC_STD_MUTEX_LOCK( &g_palloc_map_mutex );
+#endif
+}
+
+void PFORK_PARENT()
+{
+#if defined(PALLOC_THREAD) && defined(PALLOC_MUTEX) && UINTPTR_MAX > 0xffffffffu
+    PALLOC_STD_MUTEX_UNLOCK( &g_palloc_map_mutex );
+#endif
+
+#if defined(PALLOC_THREAD) && defined(PALLOC_PAGES)
+    palloc_pages_unlock();
+#endif
+
+#if defined(PALLOC_THREAD) && defined(PALLOC_MUTEX)
+    PALLOC_CLASSES( PALLOC_MUTEX_UNLOCK_ENTRY )
+#endif
+}
+
+void PFORK_CHILD()
+{
+#if defined(PALLOC_THREAD) && defined(PALLOC_MUTEX)
+#   if UINTPTR_MAX > 0xffffffffu
+    PALLOC_STD_MUTEX_INIT( &g_palloc_map_mutex );
+#   endif
+
+#   if defined(PALLOC_PAGES)
+    PALLOC_STD_MUTEX_INIT( &g_palloc_pages_mutex );
+#   endif
+
+    PALLOC_CLASSES( PALLOC_MUTEX_INIT_ENTRY )
+#elif defined(PALLOC_THREAD) && defined(PALLOC_PAGES)
+    palloc_pages_unlock();
+#endif
+}
+
+size_t PTRIM()
+{
+#if defined(PALLOC_THREAD) && defined(PALLOC_CACHE)
+    palloc_cache_flush();
+#endif
+
+    size_t nbytes = 0;
+
+    PALLOC_CLASSES( PALLOC_TRIM_ENTRY )
+
+    return nbytes;
+}
+
+void * PALLOC( size_t nbytes )
+{
+    if( nbytes == 0 )
+    {
+        nbytes = 1;
+    }
+
+    if( nbytes > PALLOC_THRESHOLD )
+    {
+        void * p = palloc_large_alloc( nbytes, PALLOC_ALIGNMENT );
+
+        return p;
+    }
+
+    int index = PALLOC_INDEX( nbytes );
+
+    PALLOC_STATS_ALLOC( index, nbytes );
+
+    unsigned char * p = PALLOC_ALLOC( index );
+
+    return (void *)p;
+}
+
+void * PALLOC_SIZED( size_t nbytes, size_t * actual )
+{
+    if( nbytes == 0 )
+    {
+        nbytes = 1;
+    }
+
+    if( nbytes > PALLOC_THRESHOLD )
+    {
+        void * p = palloc_large_alloc( nbytes, PALLOC_ALIGNMENT );
+
+        *actual = 0;
+
+        if( p != NULL )
+        {
+            palloc_large_pq( (unsigned char *)p, actual );
+        }
+
+        return p;
+    }
+
+    int index = PALLOC_INDEX( nbytes );
+
+    PALLOC_STATS_ALLOC( index, nbytes );
+
+    unsigned char * p = PALLOC_ALLOC( index );
+
+    *actual = palloc_size_table[index];
+
+    return (void *)p;
+}
+
+#ifndef PALLOC_CLEAR_INLINE
+#   define PALLOC_CLEAR_INLINE 32
+#endif
+
+typedef struct palloc_clear_t
+{
+    unsigned long long w[2];
+} palloc_clear_t;
+
+typedef char palloc_check_clear[sizeof( palloc_clear_t ) == PALLOC_ALIGNMENT ? 1 : -1];
+
+// Blocks are aligned to and sized in multiples of 16 bytes, so the smallest
+// ones are cleared with inline 16-byte vector stores, which beats the call to
+// memset only up to a few of them; memset clears the rest with wide stores of
+// its own.
+static PALLOC_FORCEINLINE void palloc_clear( unsigned char * p, size_t nbytes )
+{
+    if( nbytes > PALLOC_CLEAR_INLINE )
+    {
+        PALLOC_STD_MEMSET( p, 0, nbytes );
+
+        return;
+    }
+
+    palloc_clear_t * c = (palloc_clear_t *)p;
+    palloc_clear_t * e = (palloc_clear_t *)(p + ((nbytes + PALLOC_ALIGNMENT - 1) & ~(size_t)(PALLOC_ALIGNMENT - 1)));
+
+    for( ; c != e; ++c )
+    {
+        c->w[0] = 0;
+        c->w[1] = 0;
+    }
+}
+
+void * PCALLOC( size_t count, size_t nbytes )
+{
+    if( nbytes != 0 && count > (size_t)-1 / nbytes )
+    {
+        return NULL;
+    }
+
+    nbytes *= count;
+
+    if( nbytes == 0 )
+    {
+        nbytes = 1;
+    }
+
+    if( nbytes > PALLOC_THRESHOLD )
+    {
+        void * p = palloc_large_calloc( nbytes );
+
+        return p;
+    }
+
+    int index = PALLOC_INDEX( nbytes );
+
+    PALLOC_STATS_ALLOC( index, nbytes );
+
+    unsigned char * p = PALLOC_ALLOC( index );
+
+    // blocks never handed out of a zero filled chunk only hold their link;
+    // the second word is only read once the chunk is known to be zero filled,
+    // in other chunks it may never have been written
+    if( palloc_map_zero( p ) && ((void **)p)[1] == NULL )
+    {
+        ((void **)p)[0] = NULL;
+
+        return (void *)p;
+    }
+
+    palloc_clear( p, nbytes );
+
+    return (void *)p;
+}
+
+void PFREE( void * p )
+{
+    if( p == NULL )
+    {
+        return;
+    }
+
+    int index = palloc_map_index( p );
+
+    if( index == -1 )
+    {
+        palloc_large_free( p );
+
+        return;
+    }
+
+    PALLOC_STATS_FREE( index );
+
+    PALLOC_FREE( index, p );
+}
+
+void PFREE_SIZED( void * p, size_t nbytes )
+{
+    if( p == NULL )
+    {
+        return;
+    }
+
+    if( nbytes == 0 )
+    {
+        nbytes = 1;
+    }
+
+    if( nbytes > PALLOC_THRESHOLD )
+    {
+        PALLOC_STD_ASSERT( palloc_map_index( p ) == -1 && PMALLOC_USABLE_SIZE( p ) >= nbytes );
+
+        palloc_large_free( p );
+
+        return;
+    }
+
+    int index = PALLOC_INDEX( nbytes );
+
+    PALLOC_STD_ASSERT( palloc_map_index( p ) == index );
+
+    PALLOC_STATS_FREE( index );
+
+    PALLOC_FREE( index, p );
+}
+
+void * PREALLOC( void * p, size_t nbytes )
+{
+    if( p == NULL )
+    {
+        void * new_p = PALLOC( nbytes );
+
+        return new_p;
+    }
+
+    if( nbytes == 0 )
+    {
+        nbytes = 1;
+    }
+
+    int old_index = palloc_map_index( p );
+
+    if( old_index == -1 )
+    {
+        if( nbytes > PALLOC_THRESHOLD )
+        {
+            void * new_p = palloc_large_realloc( p, nbytes );
+
+            return new_p;
+        }
+
+        int new_index = PALLOC_INDEX( nbytes );
+
+        PALLOC_STATS_ALLOC( new_index, nbytes );
+
+        unsigned char * new_p = PALLOC_ALLOC( new_index );
+
+        // aligned large blocks may be smaller than the class they move to
+        size_t old_nbytes;
+        palloc_large_pq( (unsigned char *)p, &old_nbytes );
+
+        PALLOC_STD_MEMCPY( new_p, p, old_nbytes < nbytes ? old_nbytes : nbytes );
+
+        palloc_large_free( p );
+
+        return new_p;
+    }
+
+    size_t old_nbytes = palloc_size_table[old_index];
+
+    // shrinking by less than half keeps the block, so a grown buffer is not
+    // moved back into a smaller class by the next append
+    if( nbytes <= old_nbytes && nbytes >= old_nbytes / 2 )
+    {
+        return p;
+    }
+
+    size_t grow_nbytes = palloc_grow_nbytes( old_nbytes, nbytes );
+
+    if( nbytes <= PALLOC_THRESHOLD && grow_nbytes > PALLOC_THRESHOLD )
+    {
+        grow_nbytes = PALLOC_THRESHOLD;
+    }
+
+    nbytes = grow_nbytes;
+
+    if( nbytes > PALLOC_THRESHOLD )
+    {
+        void * new_p = palloc_large_alloc( nbytes, PALLOC_ALIGNMENT );
+
+        if( new_p == NULL )
+        {
+            return NULL;
+        }
+
+        PALLOC_STD_MEMCPY( new_p, p, old_nbytes );
+
+        PALLOC_STATS_FREE( old_index );
+
+        PALLOC_FREE( old_index, p );
+
+        return new_p;
+    }
+
+    int new_index = PALLOC_INDEX( nbytes );
+
+    if( old_index == new_index )
+    {
+        return p;
+    }
+
+    PALLOC_STATS_ALLOC( new_index, nbytes );
+
+    unsigned char * new_p = PALLOC_ALLOC( new_index );
+
+    size_t min_nbytes = old_nbytes < nbytes ? old_nbytes : nbytes;
+    PALLOC_STD_MEMCPY( new_p, p, min_nbytes );
+
+    PALLOC_STATS_FREE( old_index );
+
+    PALLOC_FREE( old_index, p );
+
+    return new_p;
+}
+
+void * PALIGNED_ALLOC( size_t alignment, size_t nbytes )
+{
+    if( alignment <= PALLOC_ALIGNMENT )
+    {
+        void * p = PALLOC( nbytes );
+
+        return p;
+    }
+
+    if( (alignment & (alignment - 1)) != 0 )
+    {
+        return NULL;
+    }
+
+    if( nbytes > PALLOC_THRESHOLD || alignment > PALLOC_THRESHOLD )
+    {
+        void * p = palloc_large_alloc( nbytes, alignment );
+
+        return p;
+    }
+
+    // chunks and spans are aligned to their size, so every block of a class
+    // whose size is a multiple of the alignment is aligned as well
+    size_t class_nbytes = nbytes < alignment ? alignment : nbytes;
+
+    for( int index = PALLOC_INDEX( class_nbytes ); index != PALLOC_CLASS_COUNT; ++index )
+    {
+        if( (palloc_size_table[index] & (alignment - 1)) == 0 )
+        {
+            PALLOC_STATS_ALLOC( index, nbytes );
+
+            unsigned char * p = PALLOC_ALLOC( index );
+
+            return (void *)p;
+        }
+    }
+
+    void * p = palloc_large_alloc( nbytes, alignment );
+
+    return p;
+}
+
+size_t PMALLOC_USABLE_SIZE( const void * p )
+{
+    if( p == NULL )
+    {
+        return 0;
+    }
+
+    int index = palloc_map_index( p );
+
+    if( index == -1 )
+    {
+        size_t nbytes;
+        palloc_large_pq( (unsigned char *)p, &nbytes );
+
+        return nbytes;
+    }
+
+    size_t nbytes = palloc_size_table[index];
+
+    return nbytes;
+}
+
+size_t PALLOC_BULK( size_t nbytes, size_t count, void ** out )
+{
+    if( nbytes == 0 )
+    {
+        nbytes = 1;
+    }
+
+    if( nbytes > PALLOC_THRESHOLD )
+    {
+        for( size_t i = 0; i != count; ++i )
+        {
+            out[i] = palloc_large_alloc( nbytes, PALLOC_ALIGNMENT );
+
+            if( out[i] == NULL )
+            {
+                return i;
+            }
+        }
+
+        return count;
+    }
+
+    if( count == 0 )
+    {
+        return 0;
+    }
+
+    int index = PALLOC_INDEX( nbytes );
+
+    PALLOC_STATS_ALLOC_BULK( index, count, nbytes * count );
+
+    palloc_alloc_bulk_class( index, out, count );
+
+    return count;
+}
+
+void PFREE_BULK( void ** ptrs, size_t count )
+{
+    size_t i = 0;
+
+    while( i != count )
+    {
+        void * p = ptrs[i];
+
+        if( p == NULL )
+        {
+            ++i;
+
+            continue;
+        }
+
+        int index = palloc_map_index( p );
+
+        if( index == -1 )
+        {
+            palloc_large_free( p );
+
+            ++i;
+
+            continue;
+        }
+
+        size_t j = i + 1;
+
+        while( j != count && ptrs[j] != NULL && palloc_map_index( ptrs[j] ) == index )
+        {
+            ++j;
+        }
+
+        PALLOC_STATS_FREE_BULK( index, j - i );
+
+        palloc_free_bulk_class( index, ptrs + i, j - i );
+
+        i = j;
+    }
+}
+
+// An arena is a list of chunks with a bump cursor in the current one. The
+// arena itself lives at the start of its first chunk, so creating one takes a
+// single chunk. Blocks larger than PALLOC_ARENA_LARGE are allocated on their
+// own and freed on reset instead of wasting the tail of a chunk.
+#ifndef PALLOC_ARENA_LARGE
+#   define PALLOC_ARENA_LARGE (PALLOC_CHUNK_SIZE / 4)
+#endif
+
+typedef struct palloc_arena_link_t
+{
+    struct palloc_arena_link_t * next;
+    unsigned char padding[PALLOC_ALIGNMENT - sizeof( void * )];
+} palloc_arena_link_t;
+
+struct parena_t
+{
+    unsigned char * cursor;
+    unsigned char * end;
+
+    palloc_arena_link_t * chunk;
+    palloc_arena_link_t * large;
+};
+
+#define PALLOC_ARENA_HEADER ((sizeof( struct parena_t ) + PALLOC_ALIGNMENT - 1) & ~(size_t)(PALLOC_ALIGNMENT - 1))
+
+typedef char palloc_check_arena_large[PALLOC_ARENA_LARGE <= PALLOC_CHUNK_SIZE - sizeof( palloc_arena_link_t ) - PALLOC_ARENA_HEADER ? 1 : -1];
+
+static palloc_arena_link_t * palloc_arena_first( parena_t * a )
+{
+    palloc_arena_link_t * c = (palloc_arena_link_t *)((unsigned char *)a - sizeof( palloc_arena_link_t ));
+
+    return c;
+}
+
+static void palloc_arena_free_large( parena_t * a )
+{
+    for( palloc_arena_link_t * it = a->large, * it_next; it != NULL; it = it_next )
+    {
+        it_next = it->next;
+
+        PALLOC_STD_ALIGNED_FREE( it );
+    }
+
+    a->large = NULL;
+}
+
+static PALLOC_NOINLINE void * palloc_arena_grow( parena_t * a, size_t nbytes )
+{
+    if( nbytes > PALLOC_ARENA_LARGE )
+    {
+        palloc_arena_link_t * l = (palloc_arena_link_t *)PALLOC_STD_ALIGNED_MALLOC( PALLOC_ALIGNMENT, sizeof( palloc_arena_link_t ) + nbytes );
+
+        if( l == NULL )
+        {
+            return NULL;
+        }
+
+        l->next = a->large;
+        a->large = l;
+
+        return l + 1;
+    }
+
+    // chunks stay linked after a reset and are reused before new ones
+    palloc_arena_link_t * c = a->chunk->next;
+
+    if( c == NULL )
+    {
+        c = (palloc_arena_link_t *)PALLOC_STD_CHUNK_ALLOC();
+
+        if( c == NULL )
+        {
+            return NULL;
+        }
+
+        c->next = NULL;
+        a->chunk->next = c;
+    }
+
+    a->chunk = c;
+
+    unsigned char * p = (unsigned char *)(c + 1);
+
+    a->cursor = p + nbytes;
+    a->end = (unsigned char *)c + PALLOC_CHUNK_SIZE;
+
+    return p;
+}
+
+parena_t * PARENA_CREATE()
+{
+    palloc_arena_link_t * c = (palloc_arena_link_t *)PALLOC_STD_CHUNK_ALLOC();
+
+    if( c == NULL )
+    {
+        return NULL;
+    }
+
+    c->next = NULL;
+
+    parena_t * a = (parena_t *)(c + 1);
+
+    a->cursor = (unsigned char *)a + PALLOC_ARENA_HEADER;
+    a->end = (unsigned char *)c + PALLOC_CHUNK_SIZE;
+    a->chunk = c;
+    a->large = NULL;
+
+    return a;
+}
+
+void * PARENA_ALLOC( parena_t * a, size_t nbytes )
+{
+    // the rounding and the link of a large block must not wrap the size
+    if( nbytes > SIZE_MAX - PALLOC_ALIGNMENT - sizeof( palloc_arena_link_t ) )
+    {
+        return NULL;
+    }
+
+    nbytes = nbytes == 0 ? PALLOC_ALIGNMENT : (nbytes + PALLOC_ALIGNMENT - 1) & ~(size_t)(PALLOC_ALIGNMENT - 1);
+
+    if( nbytes <= (size_t)(a->end - a->cursor) )
+    {
+        unsigned char * p = a->cursor;
+
+        a->cursor = p + nbytes;
+
+        return p;
+    }
+
+    void * p = palloc_arena_grow( a, nbytes );
+
+    return p;
+}
+
+void PARENA_RESET( parena_t * a )
+{
+    palloc_arena_free_large( a );
+
+    palloc_arena_link_t * c = palloc_arena_first( a );
+
+    a->cursor = (unsigned char *)a + PALLOC_ARENA_HEADER;
+    a->end = (unsigned char *)c + PALLOC_CHUNK_SIZE;
+    a->chunk = c;
+}
+
+void PARENA_DESTROY( parena_t * a )
+{
+    if( a == NULL )
+    {
+        return;
+    }
+
+    palloc_arena_free_large( a );
+
+    palloc_arena_link_t * c = palloc_arena_first( a );
+
+    while( c != NULL )
+    {
+        palloc_arena_link_t * c_next = c->next;
+
+        PALLOC_STD_CHUNK_FREE( c );
+
+        c = c_next;
+    }
+}
+
+#if defined(PALLOC_STATS)
+pstats_t PSTATS()
+{
+#   if defined(PALLOC_THREAD) && defined(PALLOC_CACHE)
+    palloc_stats_publish_all();
+#   endif
+
+    pstats_t s;
+    PALLOC_STD_MEMSET( &s, 0, sizeof( s ) );
+
+    for( int k = 0; k != PALLOC_STATS_SHARD_COUNT; ++k )
+    {
+        palloc_stats_shard_t * shard = g_palloc_stats + k;
+
+        for( int i = 0; i != PALLOC_CLASS_COUNT; ++i )
+        {
+            s.classes[i].allocs += (size_t)PALLOC_STATS_LOAD( shard->classes[i].allocs );
+            s.classes[i].frees += (size_t)PALLOC_STATS_LOAD( shard->classes[i].frees );
+            s.classes[i].refills += (size_t)PALLOC_STATS_LOAD( shard->classes[i].refills );
+            s.classes[i].requested += (size_t)PALLOC_STATS_LOAD( shard->classes[i].requested );
+        }
+
+        s.large_allocs += (size_t)PALLOC_STATS_LOAD( shard->large_allocs );
+        s.large_frees += (size_t)PALLOC_STATS_LOAD( shard->large_frees );
+        s.large_bytes += (size_t)PALLOC_STATS_LOAD( shard->large_bytes );
+    }
+
+    for( int i = 0; i != PALLOC_CLASS_COUNT; ++i )
+    {
+        pstats_class_t * c = s.classes + i;
+
+        c->nbytes = palloc_size_table[i];
+        c->live = c->allocs - c->frees;
+        c->chunks = palloc_map_chunks( i, NULL, 0 );
+        c->reserved = c->chunks * PALLOC_SPAN_SIZE( PALLOC_CLASS_ORDER( i ) );
+
+        s.allocs += c->allocs;
+        s.frees += c->frees;
+    }
+
+    s.large_live = s.large_allocs - s.large_frees;
+
+    s.allocs += s.large_allocs;
+    s.frees += s.large_frees;
+
+    return s;
+}
+
+static size_t palloc_stats_print( char * buffer, size_t capacity, size_t length, const char * format, ... )
+{
+    va_list args;
+    va_start( args, format );
+
+    int n = length < capacity
+        ? PALLOC_STD_VSNPRINTF( buffer + length, capacity - length, format, args )
+        : PALLOC_STD_VSNPRINTF( NULL, 0, format, args );
+
+    va_end( args );
+
+    if( n < 0 )
+    {
+        return length;
+    }
+
+    return length + (size_t)n;
+}
+
+size_t PSTATS_DUMP( const pstats_t * s, int format, char * buffer, size_t capacity )
+{
+    size_t n = 0;
+
+    if( format == PSTATS_JSON )
+    {
+        n = palloc_stats_print( buffer, capacity, n, "{\"classes\":[" );
+
+        for( int i = 0; i != PSTATS_CLASS_COUNT; ++i )
+        {
+            const pstats_class_t * c = s->classes + i;
+
+            n = palloc_stats_print( buffer, capacity, n
+                , "%s{\"nbytes\":%llu,\"allocs\":%llu,\"frees\":%llu,\"live\":%llu,\"refills\":%llu,\"chunks\":%llu,\"reserved\":%llu,\"requested\":%llu}"
+                , i == 0 ? "" : ","
+                , (unsigned long long)c->nbytes, (unsigned long long)c->allocs, (unsigned long long)c->frees, (unsigned long long)c->live
+                , (unsigned long long)c->refills, (unsigned long long)c->chunks, (unsigned long long)c->reserved, (unsigned long long)c->requested );
+        }
+
+        n = palloc_stats_print( buffer, capacity, n
+            , "],\"large\":{\"allocs\":%llu,\"frees\":%llu,\"live\":%llu,\"bytes\":%llu},\"allocs\":%llu,\"frees\":%llu}"
+            , (unsigned long long)s->large_allocs, (unsigned long long)s->large_frees, (unsigned long long)s->large_live, (unsigned long long)s->large_bytes
+            , (unsigned long long)s->allocs, (unsigned long long)s->frees );
+    }
+    else
+    {
+        n = palloc_stats_print( buffer, capacity, n, "%8s %12s %12s %12s %10s %8s %12s %14s\n"
+            , "nbytes", "allocs", "frees", "live", "refills", "chunks", "reserved", "requested" );
+
+        for( int i = 0; i != PSTATS_CLASS_COUNT; ++i )
+        {
+            const pstats_class_t * c = s->classes + i;
+
+            n = palloc_stats_print( buffer, capacity, n, "%8llu %12llu %12llu %12llu %10llu %8llu %12llu %14llu\n"
+                , (unsigned long long)c->nbytes, (unsigned long long)c->allocs, (unsigned long long)c->frees, (unsigned long long)c->live
+                , (unsigned long long)c->refills, (unsigned long long)c->chunks, (unsigned long long)c->reserved, (unsigned long long)c->requested );
+        }
+
+        n = palloc_stats_print( buffer, capacity, n, "%8s %12llu %12llu %12llu %10s %8s %12llu\n"
+            , "large", (unsigned long long)s->large_allocs, (unsigned long long)s->large_frees, (unsigned long long)s->large_live
+            , "", "", (unsigned long long)s->large_bytes );
+
+        n = palloc_stats_print( buffer, capacity, n, "%8s %12llu %12llu\n"
+            , "total", (unsigned long long)s->allocs, (unsigned long long)s->frees );
+    }
+
+    return n;
+}
+#endif
@@ -0,0 +1,151 @@
+// Interposes the C allocation functions with palloc when the shared library
+// built with PALLOC_PRELOAD is loaded through LD_PRELOAD. palloc initializes
+// itself on the first call, which may come from the dynamic loader or from
+// constructors of other libraries before this one's constructor runs, so it
+// must happen before a second thread is started. Blocks are never returned
+// with PFINI since other libraries may still free theirs at exit. The fork
+// handlers are registered on the first allocation, ahead of those of most
+// libraries, so they run after theirs before a fork and before theirs after
+// it, and libraries that allocate in their handlers do not deadlock.
+#include "palloc/palloc.h"
+
+#include <errno.h>
+#include <malloc.h>
+#include <stdlib.h>
+
+#if defined(PALLOC_THREAD)
+#   include <pthread.h>
+#endif
+
+static volatile int g_palloc_preload_ready = 0;
+
+__attribute__((visibility("hidden"))) void palloc_preload_init()
+{
+    if( g_palloc_preload_ready == 1 )
+    {
+        return;
+    }
+
+    g_palloc_preload_ready = 1;
+
+    PINIT();
+
+#if defined(PALLOC_THREAD)
+    pthread_atfork( &PFORK_PREPARE, &PFORK_PARENT, &PFORK_CHILD );
+#endif
+}
+
+__attribute__((constructor)) static void palloc_preload_load()
+{
+    palloc_preload_init();
+}
+
+void * malloc( size_t nbytes )
+{
+    palloc_preload_init();
+
+    void * p = PALLOC( nbytes );
+
+    if( p == NULL )
+    {
+        errno = ENOMEM;
+    }
+
+    return p;
+}
+
+void free( void * p )
+{
+    PFREE( p );
+}
+
+void * calloc( size_t count, size_t nbytes )
+{
+    palloc_preload_init();
+
+    void * p = PCALLOC( count, nbytes );
+
+    if( p == NULL )
+    {
+        errno = ENOMEM;
+    }
+
+    return p;
+}
+
+void * realloc( void * p, size_t nbytes )
+{
+    palloc_preload_init();
+
+    void * new_p = PREALLOC( p, nbytes );
+
+    if( new_p == NULL )
+    {
+        errno = ENOMEM;
+    }
+
+    return new_p;
+}
+
+void * aligned_alloc( size_t alignment, size_t nbytes )
+{
+    palloc_preload_init();
+
+    void * p = PALIGNED_ALLOC( alignment, nbytes );
+
+    if( p == NULL )
+    {
+        errno = (alignment & (alignment - 1)) != 0 ? EINVAL : ENOMEM;
+    }
+
+    return p;
+}
+
+void * memalign( size_t alignment, size_t nbytes )
+{
+    void * p = aligned_alloc( alignment, nbytes );
+
+    return p;
+}
+
+int posix_memalign( void ** out, size_t alignment, size_t nbytes )
+{
+    if( alignment < sizeof( void * ) || (alignment & (alignment - 1)) != 0 )
+    {
+        return EINVAL;
+    }
+
+    palloc_preload_init();
+
+    void * p = PALIGNED_ALLOC( alignment, nbytes );
+
+    if( p == NULL )
+    {
+        return ENOMEM;
+    }
+
+    *out = p;
+
+    return 0;
+}
+
+void * valloc( size_t nbytes )
+{
+    void * p = aligned_alloc( 4096, nbytes );
+
+    return p;
+}
+
+void * pvalloc( size_t nbytes )
+{
+    void * p = aligned_alloc( 4096, (nbytes + 4095) & ~(size_t)4095 );
+
+    return p;
+}
+
+size_t malloc_usable_size( void * p )
+{
+    size_t nbytes = PMALLOC_USABLE_SIZE( p );
+
+    return nbytes;
+}
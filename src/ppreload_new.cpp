@@ -0,0 +1,7 @@
+// The global operator new and delete of the interposing library, they run the
+// same lazy initialization as its malloc.
+extern "C" void palloc_preload_init();
+
+#define PALLOC_PNEW_ENTER() palloc_preload_init()
+
+#include "palloc/pnew.h"
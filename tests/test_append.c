@@ -0,0 +1,170 @@
+#include "palloc/palloc.h"
+
+#include "test_platform.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_BUFFERS 32
+#define NUM_ROUNDS 4
+
+typedef struct
+{
+    const char * name;
+    size_t max_nbytes;
+    size_t max_append;
+} append_workload_t;
+
+// string builders appending short pieces, and vector-like buffers growing
+// into the large classes
+static const append_workload_t workloads[] = {
+    {"strings", 2000, 12},
+    {"buffers", 64 << 10, 64},
+    {"large buffers", 1 << 20, 16384}
+};
+
+static unsigned int rnd_state = 12345;
+
+static size_t rnd_range( size_t min_nbytes, size_t max_nbytes )
+{
+    rnd_state = rnd_state * 1103515245u + 12345u;
+
+    size_t nbytes = min_nbytes + (rnd_state >> 8) % (max_nbytes - min_nbytes + 1);
+
+    return nbytes;
+}
+
+static void * test_realloc( void * p, size_t nbytes )
+{
+    return realloc( p, nbytes );
+}
+
+static void test_free( void * p )
+{
+    free( p );
+}
+
+static void * test_prealloc( void * p, size_t nbytes )
+{
+    return PREALLOC( p, nbytes );
+}
+
+static void test_pfree( void * p )
+{
+    PFREE( p );
+}
+
+static int test_append( const append_workload_t * w, void * (*r)(void *, size_t), void (*f)(void *), double * seconds, size_t * moves, size_t * calls )
+{
+    static unsigned char * buffers[NUM_BUFFERS];
+    static size_t sizes[NUM_BUFFERS];
+
+    *moves = 0;
+    *calls = 0;
+
+    double t0 = test_time();
+
+    for( int round = 0; round != NUM_ROUNDS; ++round )
+    {
+        rnd_state = 12345;
+
+        for( int i = 0; i != NUM_BUFFERS; ++i )
+        {
+            buffers[i] = NULL;
+            sizes[i] = 0;
+        }
+
+        for( int live = NUM_BUFFERS; live != 0; )
+        {
+            for( int i = 0; i != NUM_BUFFERS; ++i )
+            {
+                if( sizes[i] >= w->max_nbytes )
+                {
+                    continue;
+                }
+
+                size_t n = rnd_range( 1, w->max_append );
+
+                unsigned char * p = (unsigned char *)(*r)( buffers[i], sizes[i] + n );
+
+                if( p == NULL )
+                {
+                    return 0;
+                }
+
+                if( buffers[i] != NULL && p != buffers[i] )
+                {
+                    ++*moves;
+                }
+
+                ++*calls;
+
+                if( sizes[i] != 0 && p[sizes[i] - 1] != (unsigned char)(sizes[i] - 1) )
+                {
+                    return 0;
+                }
+
+                for( size_t j = sizes[i]; j != sizes[i] + n; ++j )
+                {
+                    p[j] = (unsigned char)j;
+                }
+
+                buffers[i] = p;
+                sizes[i] += n;
+
+                if( sizes[i] >= w->max_nbytes )
+                {
+                    --live;
+                }
+            }
+        }
+
+        for( int i = 0; i != NUM_BUFFERS; ++i )
+        {
+            (*f)( buffers[i] );
+        }
+    }
+
+    double t1 = test_time();
+
+    *seconds = t1 - t0;
+
+    return 1;
+}
+
+int main( void )
+{
+    PINIT();
+
+    printf( "%-14s %12s %12s %12s %12s\n", "workload", "prealloc", "moves", "realloc", "moves" );
+
+    for( size_t k = 0; k != sizeof( workloads ) / sizeof( workloads[0] ); ++k )
+    {
+        const append_workload_t * w = workloads + k;
+
+        double p_seconds;
+        size_t p_moves;
+        size_t p_calls;
+
+        if( test_append( w, &test_prealloc, &test_pfree, &p_seconds, &p_moves, &p_calls ) == 0 )
+        {
+            return EXIT_FAILURE;
+        }
+
+        double m_seconds;
+        size_t m_moves;
+        size_t m_calls;
+
+        if( test_append( w, &test_realloc, &test_free, &m_seconds, &m_moves, &m_calls ) == 0 )
+        {
+            return EXIT_FAILURE;
+        }
+
+        printf( "%-14s %9.2f ms %12zu %9.2f ms %12zu\n", w->name, p_seconds * 1e3, p_moves, m_seconds * 1e3, m_moves );
+    }
+
+    PFINI();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,227 @@
+#include "palloc/palloc.h"
+
+#include "test_platform.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_OBJECTS 500
+#define NUM_REQUESTS 20000
+#define NUM_THREADS 4
+
+static void * ptrs[NUM_OBJECTS];
+
+static size_t object_size( int i )
+{
+    size_t nbytes = (size_t)(i * 37 % 200);
+
+    return nbytes;
+}
+
+static int fill_arena( parena_t * a, int salt )
+{
+    unsigned char * prev = NULL;
+
+    for( int i = 0; i != NUM_OBJECTS; ++i )
+    {
+        size_t nbytes = object_size( i ) * (i % 50 == 0 ? 200 : 1);
+
+        unsigned char * p = (unsigned char *)PARENA_ALLOC( a, nbytes );
+
+        if( p == NULL || ((size_t)p & 15) != 0 || p == prev )
+        {
+            return 0;
+        }
+
+        memset( p, (i + salt) & 0xff, nbytes );
+
+        ptrs[i] = p;
+        prev = p;
+    }
+
+    for( int i = 0; i != NUM_OBJECTS; ++i )
+    {
+        size_t nbytes = object_size( i ) * (i % 50 == 0 ? 200 : 1);
+
+        const unsigned char * p = (const unsigned char *)ptrs[i];
+
+        for( size_t j = 0; j != nbytes; ++j )
+        {
+            if( p[j] != (unsigned char)((i + salt) & 0xff) )
+            {
+                return 0;
+            }
+        }
+    }
+
+    return 1;
+}
+
+static int test_arena()
+{
+    parena_t * a = PARENA_CREATE();
+
+    if( a == NULL )
+    {
+        return 0;
+    }
+
+    for( int r = 0; r != 8; ++r )
+    {
+        if( fill_arena( a, r ) == 0 )
+        {
+            return 0;
+        }
+
+        PARENA_RESET( a );
+    }
+
+    // a reset arena reuses its memory from the start
+    void * p0 = PARENA_ALLOC( a, 24 );
+    PARENA_RESET( a );
+    void * p1 = PARENA_ALLOC( a, 24 );
+
+    if( p0 != p1 )
+    {
+        return 0;
+    }
+
+    // sizes the rounding would wrap fail and leave the arena usable
+    if( PARENA_ALLOC( a, SIZE_MAX ) != NULL || PARENA_ALLOC( a, SIZE_MAX - 8 ) != NULL || PARENA_ALLOC( a, SIZE_MAX - 16 ) != NULL || PARENA_ALLOC( a, 24 ) == NULL )
+    {
+        return 0;
+    }
+
+    PARENA_DESTROY( a );
+    PARENA_DESTROY( NULL );
+
+    return 1;
+}
+
+#if defined(PALLOC_THREAD)
+TEST_THREAD_DECL( thread_func, lpParam )
+{
+    (void)lpParam;
+
+    parena_t * a = PARENA_CREATE();
+
+    for( int r = 0; r != 1000; ++r )
+    {
+        for( int i = 0; i != NUM_OBJECTS; ++i )
+        {
+            unsigned char * p = (unsigned char *)PARENA_ALLOC( a, 64 );
+
+            if( p == NULL )
+            {
+                TEST_THREAD_RETURN( EXIT_FAILURE );
+            }
+
+            p[0] = (unsigned char)i;
+        }
+
+        PARENA_RESET( a );
+    }
+
+    PARENA_DESTROY( a );
+
+    TEST_THREAD_RETURN( EXIT_SUCCESS );
+}
+
+static int test_threads()
+{
+    test_thread_t threads[NUM_THREADS];
+
+    for( int i = 0; i != NUM_THREADS; ++i )
+    {
+        if( test_thread_create( threads + i, &thread_func, NULL ) != 0 )
+        {
+            return 0;
+        }
+    }
+
+    int result = 1;
+
+    for( int i = 0; i != NUM_THREADS; ++i )
+    {
+        if( test_thread_join( threads[i] ) != EXIT_SUCCESS )
+        {
+            result = 0;
+        }
+    }
+
+    return result;
+}
+#endif
+
+static double bench_palloc()
+{
+    double t0 = test_time();
+
+    for( int r = 0; r != NUM_REQUESTS; ++r )
+    {
+        for( int i = 0; i != NUM_OBJECTS; ++i )
+        {
+            ptrs[i] = PALLOC( object_size( i ) );
+        }
+
+        for( int i = 0; i != NUM_OBJECTS; ++i )
+        {
+            PFREE( ptrs[i] );
+        }
+    }
+
+    double t1 = test_time();
+
+    return (t1 - t0) * 1e9 / ((double)NUM_REQUESTS * NUM_OBJECTS);
+}
+
+static double bench_arena()
+{
+    parena_t * a = PARENA_CREATE();
+
+    double t0 = test_time();
+
+    for( int r = 0; r != NUM_REQUESTS; ++r )
+    {
+        for( int i = 0; i != NUM_OBJECTS; ++i )
+        {
+            ptrs[i] = PARENA_ALLOC( a, object_size( i ) );
+        }
+
+        PARENA_RESET( a );
+    }
+
+    double t1 = test_time();
+
+    PARENA_DESTROY( a );
+
+    return (t1 - t0) * 1e9 / ((double)NUM_REQUESTS * NUM_OBJECTS);
+}
+
+int main( void )
+{
+    PINIT();
+
+    if( test_arena() == 0 )
+    {
+        return EXIT_FAILURE;
+    }
+
+#if defined(PALLOC_THREAD)
+    if( test_threads() == 0 )
+    {
+        return EXIT_FAILURE;
+    }
+#endif
+
+    double palloc_ns = bench_palloc();
+    double arena_ns = bench_arena();
+
+    printf( "palloc/pfree: %6.2f ns parena_alloc/reset: %6.2f ns per object\n", palloc_ns, arena_ns );
+
+    PFINI();
+
+    return EXIT_SUCCESS;
+}
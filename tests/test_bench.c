@@ -0,0 +1,637 @@
+#include "palloc/palloc.h"
+
+#include "test_platform.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Throughput and resident memory of palloc against the system malloc. Every
+// workload runs once per allocator and reports ops/sec (one op is one
+// allocation, free or reallocation) and the growth of the process RSS
+// while the workload holds its live set. Both allocators share the process,
+// so the RSS of the second run reuses pages the first one may have kept.
+
+#define NUM_THREADS 4
+#define NUM_LIVE 64
+#define NUM_LATENCY 1000000
+#define NUM_REALLOC 2000
+#define NUM_HANDOFF 400000
+#define NUM_BATCH 64
+#define MAX_QUEUED 4096
+#define NUM_LARSON_SLOTS 4096
+#define NUM_LARSON_ROUNDS 100000
+#define NUM_LARSON_GENERATIONS 8
+
+typedef struct
+{
+    const char * name;
+    void * (*alloc)(size_t);
+    void (*free)(void *);
+    void * (*realloc)(void *, size_t);
+} bench_allocator_t;
+
+static void * bench_palloc( size_t nbytes )
+{
+    return PALLOC( nbytes );
+}
+
+static void bench_pfree( void * p )
+{
+    PFREE( p );
+}
+
+static void * bench_prealloc( void * p, size_t nbytes )
+{
+    return PREALLOC( p, nbytes );
+}
+
+static void * bench_malloc( size_t nbytes )
+{
+    return malloc( nbytes );
+}
+
+static void bench_free( void * p )
+{
+    free( p );
+}
+
+static void * bench_realloc_crt( void * p, size_t nbytes )
+{
+    return realloc( p, nbytes );
+}
+
+static const bench_allocator_t allocators[] = {
+    {"palloc", &bench_palloc, &bench_pfree, &bench_prealloc},
+    {"malloc", &bench_malloc, &bench_free, &bench_realloc_crt}
+};
+
+#define NUM_ALLOCATORS (sizeof( allocators ) / sizeof( allocators[0] ))
+
+typedef struct
+{
+    double ops;
+    size_t rss;
+} bench_result_t;
+
+static size_t bench_rss_growth( size_t rss0 )
+{
+    size_t rss = test_rss();
+
+    return rss > rss0 ? rss - rss0 : 0;
+}
+
+// single thread alloc/free with NUM_LIVE blocks of one size kept live
+static bench_result_t bench_latency( const bench_allocator_t * a, size_t nbytes )
+{
+    void * ptrs[NUM_LIVE];
+
+    size_t rss0 = test_rss();
+
+    for( int i = 0; i != NUM_LIVE; ++i )
+    {
+        ptrs[i] = (*a->alloc)( nbytes );
+    }
+
+    double t0 = test_time();
+
+    for( int i = 0; i != NUM_LATENCY; ++i )
+    {
+        int k = i % NUM_LIVE;
+
+        (*a->free)( ptrs[k] );
+
+        ptrs[k] = (*a->alloc)( nbytes );
+    }
+
+    double t1 = test_time();
+
+    bench_result_t result;
+    result.ops = 2.0 * NUM_LATENCY / (t1 - t0);
+    result.rss = bench_rss_growth( rss0 );
+
+    for( int i = 0; i != NUM_LIVE; ++i )
+    {
+        (*a->free)( ptrs[i] );
+    }
+
+    return result;
+}
+
+// buffers appended to in small steps or doubled, as strings and vectors grow
+static bench_result_t bench_realloc( const bench_allocator_t * a )
+{
+    void * ptrs[NUM_LIVE];
+
+    size_t rss0 = test_rss();
+
+    double t0 = test_time();
+
+    size_t ops = 0;
+
+    for( int r = 0; r != NUM_REALLOC / NUM_LIVE; ++r )
+    {
+        for( int i = 0; i != NUM_LIVE; ++i )
+        {
+            ptrs[i] = NULL;
+        }
+
+        for( size_t nbytes = 16; nbytes <= 8192; nbytes += 16 )
+        {
+            for( int i = 0; i != NUM_LIVE; ++i )
+            {
+                ptrs[i] = (*a->realloc)( ptrs[i], nbytes );
+
+                *(unsigned char *)ptrs[i] = (unsigned char)i;
+            }
+
+            ops += NUM_LIVE;
+        }
+
+        for( size_t nbytes = 16384; nbytes <= 1024 * 1024; nbytes *= 2 )
+        {
+            for( int i = 0; i != NUM_LIVE / 8; ++i )
+            {
+                ptrs[i] = (*a->realloc)( ptrs[i], nbytes );
+
+                *(unsigned char *)ptrs[i] = (unsigned char)i;
+            }
+
+            ops += NUM_LIVE / 8;
+        }
+
+        for( int i = 0; i != NUM_LIVE; ++i )
+        {
+            (*a->free)( ptrs[i] );
+        }
+
+        ops += NUM_LIVE;
+    }
+
+    double t1 = test_time();
+
+    bench_result_t result;
+    result.ops = (double)ops / (t1 - t0);
+    result.rss = bench_rss_growth( rss0 );
+
+    return result;
+}
+
+#if defined(PALLOC_THREAD)
+static unsigned int bench_rand( unsigned int * state )
+{
+    *state = *state * 1103515245u + 12345u;
+
+    return *state >> 8;
+}
+
+// sizes weighted towards small blocks like a typical heap
+static size_t bench_size( unsigned int * state )
+{
+    unsigned int r = bench_rand( state );
+
+    switch( r & 3 )
+    {
+    case 0:
+    case 1:
+        return 8 + (r >> 2) % 120;
+    case 2:
+        return 128 + (r >> 2) % 896;
+    default:
+        return 1024 + (r >> 2) % 3072;
+    }
+}
+
+// blocks handed to another thread are linked through their first word
+typedef struct bench_queue_t
+{
+    test_mutex_t mutex;
+    void * head;
+    size_t count;
+} bench_queue_t;
+
+static void bench_queue_push( bench_queue_t * q, void * first, void * last, size_t count )
+{
+    test_mutex_lock( &q->mutex );
+
+    *(void **)last = q->head;
+    q->head = first;
+    q->count += count;
+
+    test_mutex_unlock( &q->mutex );
+}
+
+static void * bench_queue_take( bench_queue_t * q )
+{
+    test_mutex_lock( &q->mutex );
+
+    void * head = q->head;
+
+    q->head = NULL;
+    q->count = 0;
+
+    test_mutex_unlock( &q->mutex );
+
+    return head;
+}
+
+static size_t bench_queue_count( bench_queue_t * q )
+{
+    test_mutex_lock( &q->mutex );
+
+    size_t count = q->count;
+
+    test_mutex_unlock( &q->mutex );
+
+    return count;
+}
+
+typedef struct
+{
+    const bench_allocator_t * allocator;
+    bench_queue_t * send;
+    bench_queue_t * recv;
+    size_t nsend;
+    size_t nrecv;
+    unsigned int seed;
+} bench_handoff_arg_t;
+
+static size_t bench_drain( const bench_allocator_t * a, bench_queue_t * q )
+{
+    size_t n = 0;
+
+    void * p = bench_queue_take( q );
+
+    while( p != NULL )
+    {
+        void * next = *(void **)p;
+
+        (*a->free)( p );
+
+        p = next;
+        ++n;
+    }
+
+    return n;
+}
+
+// allocates nsend blocks into send and frees nrecv blocks taken from recv;
+// a full send queue is waited out while draining recv so a ring of threads
+// cannot stall
+TEST_THREAD_DECL( bench_handoff_thread, lpParam )
+{
+    bench_handoff_arg_t * arg = (bench_handoff_arg_t *)lpParam;
+
+    const bench_allocator_t * a = arg->allocator;
+
+    unsigned int seed = arg->seed;
+
+    size_t sent = 0;
+    size_t received = 0;
+
+    while( sent != arg->nsend || received != arg->nrecv )
+    {
+        if( sent != arg->nsend && bench_queue_count( arg->send ) < MAX_QUEUED )
+        {
+            void * first = NULL;
+            void * last = NULL;
+
+            size_t count = 0;
+
+            for( ; count != NUM_BATCH && sent != arg->nsend; ++count, ++sent )
+            {
+                void * p = (*a->alloc)( bench_size( &seed ) );
+
+                if( p == NULL )
+                {
+                    TEST_THREAD_RETURN( EXIT_FAILURE );
+                }
+
+                *(void **)p = first;
+                first = p;
+
+                if( last == NULL )
+                {
+                    last = p;
+                }
+            }
+
+            bench_queue_push( arg->send, first, last, count );
+        }
+
+        size_t n = arg->recv != NULL ? bench_drain( a, arg->recv ) : 0;
+
+        received += n;
+
+        if( n == 0 && (sent == arg->nsend || bench_queue_count( arg->send ) >= MAX_QUEUED) )
+        {
+            test_yield();
+        }
+    }
+
+    TEST_THREAD_RETURN( EXIT_SUCCESS );
+}
+
+static int bench_handoff_run( bench_handoff_arg_t * args, int num_threads )
+{
+    test_thread_t threads[NUM_THREADS];
+
+    for( int i = 0; i != num_threads; ++i )
+    {
+        if( test_thread_create( threads + i, &bench_handoff_thread, args + i ) != 0 )
+        {
+            return 0;
+        }
+    }
+
+    int ok = 1;
+
+    for( int i = 0; i != num_threads; ++i )
+    {
+        if( test_thread_join( threads[i] ) != EXIT_SUCCESS )
+        {
+            ok = 0;
+        }
+    }
+
+    return ok;
+}
+
+// half of the threads allocate, the other half free what they are sent
+static int bench_producer_consumer( const bench_allocator_t * a, bench_result_t * result )
+{
+    bench_queue_t queues[NUM_THREADS / 2];
+    bench_handoff_arg_t args[NUM_THREADS];
+
+    for( int i = 0; i != NUM_THREADS / 2; ++i )
+    {
+        test_mutex_init( &queues[i].mutex );
+        queues[i].head = NULL;
+        queues[i].count = 0;
+
+        bench_handoff_arg_t producer = {a, queues + i, NULL, NUM_HANDOFF, 0, 17u + (unsigned int)i};
+        bench_handoff_arg_t consumer = {a, NULL, queues + i, 0, NUM_HANDOFF, 0};
+
+        args[2 * i] = producer;
+        args[2 * i + 1] = consumer;
+    }
+
+    size_t rss0 = test_rss();
+
+    double t0 = test_time();
+
+    int ok = bench_handoff_run( args, NUM_THREADS );
+
+    double t1 = test_time();
+
+    result->ops = 2.0 * NUM_HANDOFF * (NUM_THREADS / 2) / (t1 - t0);
+    result->rss = bench_rss_growth( rss0 );
+
+    for( int i = 0; i != NUM_THREADS / 2; ++i )
+    {
+        test_mutex_fini( &queues[i].mutex );
+    }
+
+    return ok;
+}
+
+// xmalloc-test: every thread allocates, passes its blocks to the next
+// thread and frees the blocks of the previous one
+static int bench_xmalloc( const bench_allocator_t * a, bench_result_t * result )
+{
+    bench_queue_t queues[NUM_THREADS];
+    bench_handoff_arg_t args[NUM_THREADS];
+
+    for( int i = 0; i != NUM_THREADS; ++i )
+    {
+        test_mutex_init( &queues[i].mutex );
+        queues[i].head = NULL;
+        queues[i].count = 0;
+    }
+
+    for( int i = 0; i != NUM_THREADS; ++i )
+    {
+        bench_handoff_arg_t arg = {a, queues + (i + 1) % NUM_THREADS, queues + i, NUM_HANDOFF, NUM_HANDOFF, 31u + (unsigned int)i};
+
+        args[i] = arg;
+    }
+
+    size_t rss0 = test_rss();
+
+    double t0 = test_time();
+
+    int ok = bench_handoff_run( args, NUM_THREADS );
+
+    double t1 = test_time();
+
+    result->ops = 2.0 * NUM_HANDOFF * NUM_THREADS / (t1 - t0);
+    result->rss = bench_rss_growth( rss0 );
+
+    for( int i = 0; i != NUM_THREADS; ++i )
+    {
+        test_mutex_fini( &queues[i].mutex );
+    }
+
+    return ok;
+}
+
+typedef struct
+{
+    const bench_allocator_t * allocator;
+    void ** slots;
+    unsigned int seed;
+} bench_larson_arg_t;
+
+// larson: each generation of threads takes over the slots of the previous
+// one and keeps replacing random blocks, so most frees are of blocks another
+// thread allocated
+TEST_THREAD_DECL( bench_larson_thread, lpParam )
+{
+    bench_larson_arg_t * arg = (bench_larson_arg_t *)lpParam;
+
+    const bench_allocator_t * a = arg->allocator;
+
+    unsigned int seed = arg->seed;
+
+    for( int r = 0; r != NUM_LARSON_ROUNDS; ++r )
+    {
+        size_t k = bench_rand( &seed ) % NUM_LARSON_SLOTS;
+
+        (*a->free)( arg->slots[k] );
+
+        arg->slots[k] = (*a->alloc)( bench_size( &seed ) );
+
+        if( arg->slots[k] == NULL )
+        {
+            TEST_THREAD_RETURN( EXIT_FAILURE );
+        }
+    }
+
+    arg->seed = seed;
+
+    TEST_THREAD_RETURN( EXIT_SUCCESS );
+}
+
+static int bench_larson( const bench_allocator_t * a, bench_result_t * result )
+{
+    static void * slots[NUM_THREADS][NUM_LARSON_SLOTS];
+
+    bench_larson_arg_t args[NUM_THREADS];
+
+    size_t rss0 = test_rss();
+
+    unsigned int seed = 7;
+
+    for( int i = 0; i != NUM_THREADS; ++i )
+    {
+        for( int k = 0; k != NUM_LARSON_SLOTS; ++k )
+        {
+            slots[i][k] = (*a->alloc)( bench_size( &seed ) );
+        }
+
+        args[i].allocator = a;
+        args[i].slots = slots[i];
+        args[i].seed = 101u + (unsigned int)i;
+    }
+
+    int ok = 1;
+
+    double t0 = test_time();
+
+    for( int g = 0; g != NUM_LARSON_GENERATIONS && ok == 1; ++g )
+    {
+        test_thread_t threads[NUM_THREADS];
+
+        for( int i = 0; i != NUM_THREADS; ++i )
+        {
+            if( test_thread_create( threads + i, &bench_larson_thread, args + i ) != 0 )
+            {
+                return 0;
+            }
+        }
+
+        for( int i = 0; i != NUM_THREADS; ++i )
+        {
+            if( test_thread_join( threads[i] ) != EXIT_SUCCESS )
+            {
+                ok = 0;
+            }
+        }
+    }
+
+    double t1 = test_time();
+
+    result->ops = 2.0 * NUM_LARSON_ROUNDS * NUM_THREADS * NUM_LARSON_GENERATIONS / (t1 - t0);
+    result->rss = bench_rss_growth( rss0 );
+
+    for( int i = 0; i != NUM_THREADS; ++i )
+    {
+        for( int k = 0; k != NUM_LARSON_SLOTS; ++k )
+        {
+            (*a->free)( slots[i][k] );
+        }
+    }
+
+    return ok;
+}
+#endif
+
+static void bench_report( const char * name, const bench_result_t * results )
+{
+    printf( "%-18s", name );
+
+    for( size_t i = 0; i != NUM_ALLOCATORS; ++i )
+    {
+        printf( " %14.0f %10zu", results[i].ops, results[i].rss / 1024 );
+    }
+
+    printf( "\n" );
+}
+
+int main( void )
+{
+    PINIT();
+
+#if defined(PALLOC_LOCKFREE)
+    printf( "mode: lockfree" );
+#elif defined(PALLOC_MUTEX)
+    printf( "mode: mutex" );
+#else
+    printf( "mode: single thread" );
+#endif
+
+#if defined(PALLOC_CACHE)
+    printf( " + cache\n" );
+#else
+    printf( "\n" );
+#endif
+
+    printf( "%-18s", "workload" );
+
+    for( size_t i = 0; i != NUM_ALLOCATORS; ++i )
+    {
+        printf( " %14s %10s", allocators[i].name, "rss KB" );
+    }
+
+    printf( "\n" );
+
+    static const size_t sizes[] = {16, 32, 64, 128, 256, 512, 1024, 2048, 8192};
+
+    bench_result_t results[NUM_ALLOCATORS];
+
+    for( size_t s = 0; s != sizeof( sizes ) / sizeof( sizes[0] ); ++s )
+    {
+        for( size_t i = 0; i != NUM_ALLOCATORS; ++i )
+        {
+            results[i] = bench_latency( allocators + i, sizes[s] );
+        }
+
+        char name[32];
+        snprintf( name, sizeof( name ), "latency %zu", sizes[s] );
+
+        bench_report( name, results );
+    }
+
+    for( size_t i = 0; i != NUM_ALLOCATORS; ++i )
+    {
+        results[i] = bench_realloc( allocators + i );
+    }
+
+    bench_report( "realloc growth", results );
+
+#if defined(PALLOC_THREAD)
+    for( size_t i = 0; i != NUM_ALLOCATORS; ++i )
+    {
+        if( bench_producer_consumer( allocators + i, results + i ) == 0 )
+        {
+            return EXIT_FAILURE;
+        }
+    }
+
+    bench_report( "producer/consumer", results );
+
+    for( size_t i = 0; i != NUM_ALLOCATORS; ++i )
+    {
+        if( bench_larson( allocators + i, results + i ) == 0 )
+        {
+            return EXIT_FAILURE;
+        }
+    }
+
+    bench_report( "larson", results );
+
+    for( size_t i = 0; i != NUM_ALLOCATORS; ++i )
+    {
+        if( bench_xmalloc( allocators + i, results + i ) == 0 )
+        {
+            return EXIT_FAILURE;
+        }
+    }
+
+    bench_report( "xmalloc", results );
+#endif
+
+    PFINI();
+
+    return EXIT_SUCCESS;
+}
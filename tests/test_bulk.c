@@ -0,0 +1,151 @@
+#include "palloc/palloc.h"
+
+#include "test_platform.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_BATCH 1024
+#define NUM_ROUNDS 2000
+#define NUM_LARGE 8
+
+static void * ptrs[NUM_BATCH];
+
+static int check_blocks( void ** p, size_t count, size_t nbytes )
+{
+    for( size_t i = 0; i != count; ++i )
+    {
+        if( p[i] == NULL || ((size_t)p[i] & 15) != 0 || PMALLOC_USABLE_SIZE( p[i] ) < nbytes )
+        {
+            return 0;
+        }
+
+        memset( p[i], (int)(i & 0xff), nbytes );
+    }
+
+    for( size_t i = 0; i != count; ++i )
+    {
+        const unsigned char * b = (const unsigned char *)p[i];
+
+        for( size_t j = 0; j != nbytes; ++j )
+        {
+            if( b[j] != (unsigned char)(i & 0xff) )
+            {
+                return 0;
+            }
+        }
+    }
+
+    return 1;
+}
+
+static int test_bulk()
+{
+    static const size_t sizes[] = {1, 16, 40, 100, 512, 2048, 20000};
+
+    for( int s = 0; s != 7; ++s )
+    {
+        // odd counts leave partial runs behind in the free lists and caches
+        for( size_t count = 1; count <= NUM_BATCH; count = count * 3 + 1 )
+        {
+            if( PALLOC_BULK( sizes[s], count, ptrs ) != count )
+            {
+                return 0;
+            }
+
+            if( check_blocks( ptrs, count, sizes[s] ) == 0 )
+            {
+                return 0;
+            }
+
+            PFREE_BULK( ptrs, count );
+        }
+    }
+
+    if( PALLOC_BULK( 300000, NUM_LARGE, ptrs ) != NUM_LARGE || check_blocks( ptrs, NUM_LARGE, 300000 ) == 0 )
+    {
+        return 0;
+    }
+
+    PFREE_BULK( ptrs, NUM_LARGE );
+
+    // mixed classes, large blocks and NULL entries in one call
+    for( int i = 0; i != NUM_BATCH; ++i )
+    {
+        ptrs[i] = i % 97 == 0 ? NULL : PALLOC( i % 13 == 0 ? 300000 : (size_t)(i / 100 * 24 + 8) );
+    }
+
+    PFREE_BULK( ptrs, NUM_BATCH );
+
+    if( PALLOC_BULK( 64, 0, ptrs ) != 0 )
+    {
+        return 0;
+    }
+
+    PFREE_BULK( ptrs, 0 );
+
+    return 1;
+}
+
+static double bench_single( size_t nbytes )
+{
+    double t0 = test_time();
+
+    for( int r = 0; r != NUM_ROUNDS; ++r )
+    {
+        for( int i = 0; i != NUM_BATCH; ++i )
+        {
+            ptrs[i] = PALLOC( nbytes );
+        }
+
+        for( int i = 0; i != NUM_BATCH; ++i )
+        {
+            PFREE( ptrs[i] );
+        }
+    }
+
+    double t1 = test_time();
+
+    return (t1 - t0) * 1e9 / ((double)NUM_ROUNDS * NUM_BATCH);
+}
+
+static double bench_bulk( size_t nbytes )
+{
+    double t0 = test_time();
+
+    for( int r = 0; r != NUM_ROUNDS; ++r )
+    {
+        PALLOC_BULK( nbytes, NUM_BATCH, ptrs );
+
+        PFREE_BULK( ptrs, NUM_BATCH );
+    }
+
+    double t1 = test_time();
+
+    return (t1 - t0) * 1e9 / ((double)NUM_ROUNDS * NUM_BATCH);
+}
+
+int main( void )
+{
+    PINIT();
+
+    if( test_bulk() == 0 )
+    {
+        return EXIT_FAILURE;
+    }
+
+    static const size_t sizes[] = {32, 256, 1024};
+
+    for( int s = 0; s != 3; ++s )
+    {
+        double single_ns = bench_single( sizes[s] );
+        double bulk_ns = bench_bulk( sizes[s] );
+
+        printf( "nbytes: %4d single: %6.2f ns bulk: %6.2f ns per alloc/free\n", (int)sizes[s], single_ns, bulk_ns );
+    }
+
+    PFINI();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,172 @@
+#include "palloc/palloc.h"
+
+#include "test_platform.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_OPS 128000
+#define NUM_BATCH 64
+#define NUM_CONTENTION_BATCH 4
+#define MAX_THREADS 64
+#define MAX_CONTENTION_THREADS 8
+
+#define SIZES_MIXED 0
+#define SIZES_DISTINCT 1
+#define SIZES_SAME 2
+
+typedef struct
+{
+    int thread_id;
+    int use_malloc;
+    size_t nbytes; // 0 cycles through the mixed sizes
+    int batch;
+} thread_arg_t;
+
+TEST_THREAD_DECL( thread_func, lpParam )
+{
+    thread_arg_t * myarg = (thread_arg_t *)lpParam;
+    int thread_id = myarg->thread_id;
+    int use_malloc = myarg->use_malloc;
+    int batch = myarg->batch;
+
+    static const size_t sizes[] = {8, 16, 24, 40, 60, 128, 256, 512};
+
+    void * ptrs[NUM_BATCH];
+
+    for( int r = 0; r != NUM_OPS / batch; ++r )
+    {
+        for( int i = 0; i != batch; ++i )
+        {
+            size_t sz = myarg->nbytes != 0 ? myarg->nbytes : sizes[(r + i) % 8];
+
+            ptrs[i] = use_malloc ? malloc( sz ) : PALLOC( sz );
+
+            memset( ptrs[i], thread_id, sz );
+        }
+
+        for( int i = 0; i != batch; ++i )
+        {
+            unsigned char * p = (unsigned char *)ptrs[i];
+
+            if( p[0] != (unsigned char)thread_id )
+            {
+                TEST_THREAD_RETURN( EXIT_FAILURE );
+            }
+
+            if( use_malloc )
+            {
+                free( p );
+            }
+            else
+            {
+                PFREE( p );
+            }
+        }
+    }
+
+    TEST_THREAD_RETURN( EXIT_SUCCESS );
+}
+
+// SIZES_DISTINCT gives every thread a class of its own and SIZES_SAME one
+// class to all of them; neighbouring classes, whose heads used to share
+// cache lines
+static int run( int num_threads, int use_malloc, int sizes, int batch, double * ops )
+{
+    static const size_t class_sizes[MAX_CONTENTION_THREADS] = {16, 32, 48, 64, 80, 96, 112, 128};
+
+    test_thread_t threads[MAX_THREADS];
+    thread_arg_t thread_args[MAX_THREADS];
+
+    double t0 = test_time();
+
+    for( int i = 0; i != num_threads; ++i )
+    {
+        thread_args[i].thread_id = i + 1;
+        thread_args[i].use_malloc = use_malloc;
+        thread_args[i].nbytes = sizes == SIZES_MIXED ? 0 : class_sizes[sizes == SIZES_SAME ? 0 : i % MAX_CONTENTION_THREADS];
+        thread_args[i].batch = batch;
+
+        if( test_thread_create( threads + i, &thread_func, thread_args + i ) != 0 )
+        {
+            return EXIT_FAILURE;
+        }
+    }
+
+    int result = EXIT_SUCCESS;
+
+    for( int i = 0; i != num_threads; ++i )
+    {
+        if( test_thread_join( threads[i] ) != EXIT_SUCCESS )
+        {
+            result = EXIT_FAILURE;
+        }
+    }
+
+    double t1 = test_time();
+
+    *ops = (double)num_threads * (NUM_OPS / batch) * batch * 2 / (t1 - t0);
+
+    return result;
+}
+
+int main( void )
+{
+    PINIT();
+
+#if defined(PALLOC_LOCKFREE)
+    printf( "mode: lockfree" );
+#elif defined(PALLOC_MUTEX)
+    printf( "mode: mutex" );
+#else
+    printf( "mode: thread" );
+#endif
+
+#if defined(PALLOC_CACHE)
+    printf( " + cache\n" );
+#else
+    printf( "\n" );
+#endif
+
+    // the malloc of the C library runs the same batches for comparison
+    for( int num_threads = 1; num_threads <= MAX_THREADS; num_threads *= 2 )
+    {
+        double palloc_ops;
+        if( run( num_threads, 0, SIZES_MIXED, NUM_BATCH, &palloc_ops ) != EXIT_SUCCESS )
+        {
+            return EXIT_FAILURE;
+        }
+
+        double malloc_ops;
+        if( run( num_threads, 1, SIZES_MIXED, NUM_BATCH, &malloc_ops ) != EXIT_SUCCESS )
+        {
+            return EXIT_FAILURE;
+        }
+
+        printf( "threads: %2d palloc ops/sec: %12.0f malloc ops/sec: %12.0f\n", num_threads, palloc_ops, malloc_ops );
+    }
+
+    // short batches of one class per thread reach the class head on most
+    // operations rather than staying in a cache
+    for( int num_threads = 1; num_threads <= MAX_CONTENTION_THREADS; num_threads *= 2 )
+    {
+        double distinct_ops;
+        if( run( num_threads, 0, SIZES_DISTINCT, NUM_CONTENTION_BATCH, &distinct_ops ) != EXIT_SUCCESS )
+        {
+            return EXIT_FAILURE;
+        }
+
+        double same_ops;
+        if( run( num_threads, 0, SIZES_SAME, NUM_CONTENTION_BATCH, &same_ops ) != EXIT_SUCCESS )
+        {
+            return EXIT_FAILURE;
+        }
+
+        printf( "threads: %d distinct classes ops/sec: %12.0f same class ops/sec: %12.0f\n", num_threads, distinct_ops, same_ops );
+    }
+
+    PFINI();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,262 @@
+#include "palloc/palloc.h"
+
+#include "test_platform.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_SMALL (256 << 10)
+#define NUM_BLOCKS 1024
+#define NUM_ROUNDS 20000
+#define NUM_THREADS 4
+
+static void * ptrs[NUM_BLOCKS];
+
+static int is_zero( const void * p, size_t nbytes )
+{
+    const unsigned char * b = (const unsigned char *)p;
+
+    for( size_t i = 0; i != nbytes; ++i )
+    {
+        if( b[i] != 0 )
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static int test_overflow()
+{
+    if( PCALLOC( (size_t)-1 / 2 + 1, 2 ) != NULL || PCALLOC( 2, (size_t)-1 / 2 + 1 ) != NULL || PCALLOC( (size_t)-1, (size_t)-1 ) != NULL )
+    {
+        return 0;
+    }
+
+    void * p = PCALLOC( 0, 100 );
+    void * q = PCALLOC( 100, 0 );
+
+    if( p == NULL || q == NULL )
+    {
+        return 0;
+    }
+
+    PFREE( p );
+    PFREE( q );
+
+    return 1;
+}
+
+// blocks freed with junk in them come back cleared, from the small classes
+// through the spans of the medium ones to large allocations
+static int test_reuse()
+{
+    for( size_t nbytes = 1; nbytes <= 4 * MAX_SMALL; nbytes += nbytes / 5 + 1 )
+    {
+        for( int i = 0; i != 4; ++i )
+        {
+            ptrs[i] = PALLOC( nbytes );
+            memset( ptrs[i], 0xa5, PMALLOC_USABLE_SIZE( ptrs[i] ) );
+        }
+
+        for( int i = 0; i != 4; ++i )
+        {
+            PFREE( ptrs[i] );
+        }
+
+        for( int i = 0; i != 4; ++i )
+        {
+            ptrs[i] = PCALLOC( 1, nbytes );
+
+            if( ptrs[i] == NULL || is_zero( ptrs[i], nbytes ) == 0 )
+            {
+                return 0;
+            }
+        }
+
+        for( int i = 0; i != 4; ++i )
+        {
+            PFREE( ptrs[i] );
+        }
+    }
+
+    return 1;
+}
+
+// a class is carved fresh, then every block is dirtied and freed singly or
+// in bulk, and allocated again
+static int test_class( size_t count, size_t nbytes, int bulk )
+{
+    int num_blocks = nbytes * count > 8192 ? NUM_BLOCKS / 16 : NUM_BLOCKS;
+
+    for( int round = 0; round != 3; ++round )
+    {
+        for( int i = 0; i != num_blocks; ++i )
+        {
+            ptrs[i] = PCALLOC( count, nbytes );
+
+            if( ptrs[i] == NULL || is_zero( ptrs[i], count * nbytes ) == 0 )
+            {
+                return 0;
+            }
+
+            memset( ptrs[i], 0xff, count * nbytes );
+        }
+
+        if( bulk != 0 )
+        {
+            PFREE_BULK( ptrs, (size_t)num_blocks );
+
+            continue;
+        }
+
+        for( int i = 0; i != num_blocks; ++i )
+        {
+            PFREE( ptrs[i] );
+        }
+    }
+
+    return 1;
+}
+
+#if defined(PALLOC_THREAD)
+TEST_THREAD_DECL( thread_func, lpParam )
+{
+    unsigned char thread_id = (unsigned char)*(int *)lpParam;
+
+    unsigned char * local[16];
+
+    for( int r = 0; r != NUM_ROUNDS / 16; ++r )
+    {
+        for( int i = 0; i != 16; ++i )
+        {
+            size_t nbytes = (size_t)16 << (r + i) % 12;
+
+            local[i] = (unsigned char *)PCALLOC( nbytes, 1 );
+
+            if( local[i] == NULL || is_zero( local[i], nbytes ) == 0 )
+            {
+                TEST_THREAD_RETURN( EXIT_FAILURE );
+            }
+
+            memset( local[i], thread_id, nbytes );
+        }
+
+        for( int i = 0; i != 16; ++i )
+        {
+            PFREE( local[i] );
+        }
+    }
+
+    TEST_THREAD_RETURN( EXIT_SUCCESS );
+}
+
+static int test_threads()
+{
+    test_thread_t threads[NUM_THREADS];
+    int thread_ids[NUM_THREADS];
+
+    for( int i = 0; i != NUM_THREADS; ++i )
+    {
+        thread_ids[i] = i + 1;
+
+        if( test_thread_create( threads + i, &thread_func, thread_ids + i ) != 0 )
+        {
+            return 0;
+        }
+    }
+
+    int result = 1;
+
+    for( int i = 0; i != NUM_THREADS; ++i )
+    {
+        if( test_thread_join( threads[i] ) != EXIT_SUCCESS )
+        {
+            result = 0;
+        }
+    }
+
+    return result;
+}
+#endif
+
+static void * bench_palloc_memset( size_t count, size_t nbytes )
+{
+    void * p = PALLOC( count * nbytes );
+
+    memset( p, 0, count * nbytes );
+
+    return p;
+}
+
+// zeroed allocations of nbytes with 16 of them kept live and the memory they
+// get written to, so dirty blocks are reused
+static double bench( void * (*calloc_f)(size_t, size_t), size_t nbytes, int rounds )
+{
+    for( int i = 0; i != 16; ++i )
+    {
+        ptrs[i] = NULL;
+    }
+
+    double t0 = test_time();
+
+    for( int r = 0; r != rounds; ++r )
+    {
+        int k = r & 15;
+
+        PFREE( ptrs[k] );
+
+        ptrs[k] = (*calloc_f)( 1, nbytes );
+
+        ((unsigned char *)ptrs[k])[r % nbytes] = (unsigned char)r;
+    }
+
+    double t1 = test_time();
+
+    for( int i = 0; i != 16; ++i )
+    {
+        PFREE( ptrs[i] );
+    }
+
+    return (t1 - t0) * 1e9 / rounds;
+}
+
+int main( void )
+{
+    PINIT();
+
+    if( test_overflow() == 0 || test_reuse() == 0 )
+    {
+        return EXIT_FAILURE;
+    }
+
+    if( test_class( 3, 16, 0 ) == 0 || test_class( 10, 10, 1 ) == 0 || test_class( 1, 3000, 0 ) == 0 || test_class( 100, 100, 1 ) == 0 || test_class( 4, 30000, 0 ) == 0 )
+    {
+        return EXIT_FAILURE;
+    }
+
+#if defined(PALLOC_THREAD)
+    if( test_threads() == 0 )
+    {
+        return EXIT_FAILURE;
+    }
+#endif
+
+    size_t sizes[] = {64, 1024, 16 << 10, 1 << 20};
+
+    for( int i = 0; i != 4; ++i )
+    {
+        int rounds = sizes[i] > MAX_SMALL ? NUM_ROUNDS / 10 : NUM_ROUNDS * 10;
+
+        double pcalloc_ns = bench( &PCALLOC, sizes[i], rounds );
+        double memset_ns = bench( &bench_palloc_memset, sizes[i], rounds );
+
+        printf( "%8zu bytes pcalloc: %10.2f ns palloc + memset: %10.2f ns\n", sizes[i], pcalloc_ns, memset_ns );
+    }
+
+    PFINI();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,131 @@
+#include "palloc/palloc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct
+{
+    size_t min_nbytes;
+    size_t max_nbytes;
+    size_t count;
+} workload_bucket_t;
+
+// sample size histogram of live objects; replace with a recorded one to
+// report on a real workload
+static const workload_bucket_t workload[] = {
+    {1, 16, 42000},
+    {17, 32, 31000},
+    {33, 64, 18000},
+    {65, 100, 26000},
+    {101, 128, 6000},
+    {129, 256, 9000},
+    {257, 512, 4000},
+    {520, 700, 7500},
+    {701, 1024, 1500},
+    {1025, 2048, 900}
+};
+
+#define WORKLOAD_BUCKETS (sizeof( workload ) / sizeof( workload[0] ))
+
+static unsigned int rnd_state = 12345;
+
+static size_t rnd_range( size_t min_nbytes, size_t max_nbytes )
+{
+    rnd_state = rnd_state * 1103515245u + 12345u;
+
+    size_t nbytes = min_nbytes + (rnd_state >> 8) % (max_nbytes - min_nbytes + 1);
+
+    return nbytes;
+}
+
+// reserved bytes per block of the former layout: power of two classes with
+// a 2-byte size prefix and a trailing next pointer
+static size_t pow2_reserved( size_t nbytes )
+{
+    size_t n = 16;
+    while( n <= nbytes )
+    {
+        n <<= 1;
+    }
+
+    size_t align = sizeof( void * );
+    size_t reserved = (n + 2 + sizeof( void * ) + align - 1) / align * align;
+
+    return reserved;
+}
+
+int main( void )
+{
+    PINIT();
+
+    size_t total = 0;
+    for( size_t b = 0; b != WORKLOAD_BUCKETS; ++b )
+    {
+        total += workload[b].count;
+    }
+
+    void ** ptrs = (void **)malloc( total * sizeof( void * ) );
+
+    size_t total_requested = 0;
+    size_t total_reserved = 0;
+    size_t total_pow2 = 0;
+
+    size_t k = 0;
+
+    printf( "%-12s %10s %12s %12s %8s %12s %8s\n", "bucket", "count", "requested", "reserved", "eff", "pow2", "eff" );
+
+    for( size_t b = 0; b != WORKLOAD_BUCKETS; ++b )
+    {
+        const workload_bucket_t * w = workload + b;
+
+        size_t requested = 0;
+        size_t reserved = 0;
+        size_t pow2 = 0;
+
+        for( size_t i = 0; i != w->count; ++i )
+        {
+            size_t nbytes = rnd_range( w->min_nbytes, w->max_nbytes );
+
+            void * p = PALLOC( nbytes );
+
+            size_t usable = PMALLOC_USABLE_SIZE( p );
+
+            if( usable < nbytes )
+            {
+                return EXIT_FAILURE;
+            }
+
+            ptrs[k++] = p;
+
+            requested += nbytes;
+            reserved += usable;
+            pow2 += pow2_reserved( nbytes );
+        }
+
+        char name[32];
+        snprintf( name, sizeof( name ), "%zu-%zu", w->min_nbytes, w->max_nbytes );
+
+        printf( "%-12s %10zu %12zu %12zu %7.1f%% %12zu %7.1f%%\n", name, w->count
+            , requested, reserved, 100.0 * requested / reserved
+            , pow2, 100.0 * requested / pow2 );
+
+        total_requested += requested;
+        total_reserved += reserved;
+        total_pow2 += pow2;
+    }
+
+    printf( "%-12s %10zu %12zu %12zu %7.1f%% %12zu %7.1f%%\n", "total", total
+        , total_requested, total_reserved, 100.0 * total_requested / total_reserved
+        , total_pow2, 100.0 * total_requested / total_pow2 );
+
+    for( size_t i = 0; i != k; ++i )
+    {
+        PFREE( ptrs[i] );
+    }
+
+    free( ptrs );
+
+    PFINI();
+
+    return EXIT_SUCCESS;
+}
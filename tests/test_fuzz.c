@@ -1,16 +1,21 @@
 #include "palloc/palloc.h"
 
-#define WIN32_LEAN_AND_MEAN
-#include <Windows.h>
+#include "test_platform.h"
 
 #include <stdlib.h>
 #include <time.h>
 #include <string.h>
 
 #define NUM_PROBE 1000000
-#define NUM_THREADS 64
 #define MAX_PTRS 16
 
+// without PALLOC_THREAD palloc may only be used from one thread
+#if defined(PALLOC_THREAD)
+#   define NUM_THREADS 64
+#else
+#   define NUM_THREADS 1
+#endif
+
 typedef struct
 {
     int thread_id;
@@ -38,7 +43,7 @@ static int check_mem( void * p, size_t sz, int thread_id )
     return 0;
 }
 
-static DWORD WINAPI thread_func( LPVOID lpParam )
+TEST_THREAD_DECL( thread_func, lpParam )
 {
     thread_arg_t * myarg = (thread_arg_t *)lpParam;
     int thread_id = myarg->thread_id;
@@ -58,9 +63,7 @@ static DWORD WINAPI thread_func( LPVOID lpParam )
 
         if( check_mem( ptrs[idx], sizes[idx], thread_id ) != 0 )
         {
-            ExitThread( EXIT_FAILURE );
-
-            return 0;
+            TEST_THREAD_RETURN( EXIT_FAILURE );
         }
 
         switch( action )
@@ -69,12 +72,12 @@ static DWORD WINAPI thread_func( LPVOID lpParam )
             {
                 if( p != NULL )
                 {
-                    pfree( p );
+                    PFREE( p );
                 }
 
                 size_t new_sz = 1 + rand() % 4096;
 
-                ptrs[idx] = palloc( new_sz );
+                ptrs[idx] = PALLOC( new_sz );
                 sizes[idx] = new_sz;
 
                 memset( ptrs[idx], thread_id, new_sz );
@@ -83,7 +86,7 @@ static DWORD WINAPI thread_func( LPVOID lpParam )
             {
                 size_t new_sz = 1 + rand() % 4096;
 
-                ptrs[idx] = prealloc( p, new_sz );
+                ptrs[idx] = PREALLOC( p, new_sz );
                 sizes[idx] = new_sz;
 
                 memset( ptrs[idx], thread_id, new_sz );
@@ -92,7 +95,7 @@ static DWORD WINAPI thread_func( LPVOID lpParam )
             {
                 memset( ptrs[idx], 0xFF, sizes[idx] );
 
-                pfree( p );
+                PFREE( p );
                 ptrs[idx] = NULL;
                 sizes[idx] = 0;
             } break;
@@ -101,48 +104,47 @@ static DWORD WINAPI thread_func( LPVOID lpParam )
 
     for( int i = 0; i != MAX_PTRS; ++i )
     {
-        pfree( ptrs[i] );
+        PFREE( ptrs[i] );
         ptrs[i] = NULL;
         sizes[i] = 0;
     }
 
-    ExitThread( EXIT_SUCCESS );
-
-    return 0;
+    TEST_THREAD_RETURN( EXIT_SUCCESS );
 }
 
 int main( void )
 {
     PINIT();
 
-    HANDLE threads[NUM_THREADS];
+    test_thread_t threads[NUM_THREADS];
     thread_arg_t thread_args[NUM_THREADS];
 
     for( int i = 0; i != NUM_THREADS; ++i )
     {
         thread_args[i].thread_id = i;
-        threads[i] = CreateThread( NULL, 0, &thread_func, thread_args + i, 0, NULL );
+
+        if( test_thread_create( threads + i, &thread_func, thread_args + i ) != 0 )
+        {
+            return EXIT_FAILURE;
+        }
     }
 
-    WaitForMultipleObjects( NUM_THREADS, threads, TRUE, INFINITE );
+    int result = EXIT_SUCCESS;
 
     for( int i = 0; i != NUM_THREADS; ++i )
     {
-        DWORD exit_code;
-        GetExitCodeThread( threads[i], &exit_code );
-
-        if( exit_code != EXIT_SUCCESS )
+        if( test_thread_join( threads[i] ) != EXIT_SUCCESS )
         {
-            return EXIT_FAILURE;
+            result = EXIT_FAILURE;
         }
     }
 
-    for( int i = 0; i != NUM_THREADS; ++i )
+    if( result != EXIT_SUCCESS )
     {
-        CloseHandle( threads[i] );
+        return result;
     }
 
     PFINI();
 
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
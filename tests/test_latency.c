@@ -0,0 +1,98 @@
+#include "palloc/palloc.h"
+
+#include "test_platform.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define NUM_ITERATIONS 2000000
+#define NUM_LIVE 64
+
+static void * test_malloc( size_t nbytes )
+{
+    return malloc( nbytes );
+}
+
+static void test_free( void * p )
+{
+    free( p );
+}
+
+static void * test_palloc( size_t nbytes )
+{
+    return PALLOC( nbytes );
+}
+
+static void test_pfree( void * p )
+{
+    PFREE( p );
+}
+
+static double test_latency( size_t nbytes, void * (*a)(size_t), void (*f)(void *) )
+{
+    void * ptrs[NUM_LIVE];
+
+    for( int i = 0; i != NUM_LIVE; ++i )
+    {
+        ptrs[i] = (*a)( nbytes );
+    }
+
+    double t0 = test_time();
+
+    for( int i = 0; i != NUM_ITERATIONS; ++i )
+    {
+        int k = i % NUM_LIVE;
+
+        (*f)( ptrs[k] );
+
+        ptrs[k] = (*a)( nbytes );
+    }
+
+    double t1 = test_time();
+
+    for( int i = 0; i != NUM_LIVE; ++i )
+    {
+        (*f)( ptrs[i] );
+    }
+
+    return (t1 - t0) * 1e9 / NUM_ITERATIONS;
+}
+
+int main( void )
+{
+    PINIT();
+
+    static const size_t sizes[] = {8, 16, 24, 32, 48, 64, 96, 128, 200, 256, 512, 1024};
+
+    // the first allocation of a class refills from a fresh chunk
+    printf( "size   first palloc\n" );
+
+    for( size_t s = 0; s != sizeof( sizes ) / sizeof( sizes[0] ); ++s )
+    {
+        double t0 = test_time();
+
+        void * p = PALLOC( sizes[s] );
+
+        double t1 = test_time();
+
+        PFREE( p );
+
+        printf( "%4zu   %9.2f ns\n", sizes[s], (t1 - t0) * 1e9 );
+    }
+
+    printf( "size   palloc+pfree   malloc+free\n" );
+
+    for( size_t s = 0; s != sizeof( sizes ) / sizeof( sizes[0] ); ++s )
+    {
+        size_t nbytes = sizes[s];
+
+        double p = test_latency( nbytes, &test_palloc, &test_pfree );
+        double m = test_latency( nbytes, &test_malloc, &test_free );
+
+        printf( "%4zu   %9.2f ns   %8.2f ns\n", nbytes, p, m );
+    }
+
+    PFINI();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,441 @@
+#include "palloc/palloc.h"
+
+#include "test_platform.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MIN_MEDIUM 2049
+#define MAX_MEDIUM (256 << 10)
+#define NUM_BLOCKS 256
+#define NUM_ROUNDS 20000
+#define NUM_THREADS 4
+
+static void * ptrs[NUM_BLOCKS];
+
+static unsigned int rnd_state = 12345;
+
+static size_t rnd_range( size_t min_nbytes, size_t max_nbytes )
+{
+    rnd_state = rnd_state * 1103515245u + 12345u;
+
+    size_t nbytes = min_nbytes + (rnd_state >> 8) % (max_nbytes - min_nbytes + 1);
+
+    return nbytes;
+}
+
+// every medium size gets a 16 byte aligned block of its class, at most a
+// quarter larger than asked for
+static int test_classes()
+{
+    for( size_t nbytes = MIN_MEDIUM; nbytes <= MAX_MEDIUM; nbytes += nbytes / 7 + 1 )
+    {
+        unsigned char * p = (unsigned char *)PALLOC( nbytes );
+
+        size_t usable = PMALLOC_USABLE_SIZE( p );
+
+        if( p == NULL || ((size_t)p & 15) != 0 || usable < nbytes || usable > nbytes + nbytes / 4 + 16 )
+        {
+            return 0;
+        }
+
+        memset( p, 0x5a, usable );
+
+        PFREE( p );
+    }
+
+    return 1;
+}
+
+// blocks of the classes carved from spans are distinct and keep their
+// contents, and freeing all of them lets ptrim release the spans
+static int test_spans( size_t nbytes )
+{
+    for( int i = 0; i != NUM_BLOCKS; ++i )
+    {
+        ptrs[i] = PALLOC( nbytes );
+
+        if( ptrs[i] == NULL )
+        {
+            return 0;
+        }
+
+        memset( ptrs[i], i & 0xff, nbytes );
+    }
+
+    for( int i = 0; i != NUM_BLOCKS; ++i )
+    {
+        const unsigned char * b = (const unsigned char *)ptrs[i];
+
+        if( b[0] != (unsigned char)(i & 0xff) || b[nbytes - 1] != (unsigned char)(i & 0xff) )
+        {
+            return 0;
+        }
+    }
+
+    for( int i = 0; i != NUM_BLOCKS; ++i )
+    {
+        PFREE( ptrs[i] );
+    }
+
+    if( PTRIM() < (size_t)NUM_BLOCKS * nbytes / 2 )
+    {
+        return 0;
+    }
+
+    return 1;
+}
+
+// a buffer grown from a small class through the medium ones into a large
+// allocation and back keeps its prefix
+static int test_realloc()
+{
+    unsigned char * p = NULL;
+    size_t nbytes = 0;
+
+    for( size_t new_nbytes = 100; new_nbytes <= 2 * MAX_MEDIUM; new_nbytes += new_nbytes / 3 )
+    {
+        p = (unsigned char *)PREALLOC( p, new_nbytes );
+
+        if( p == NULL )
+        {
+            return 0;
+        }
+
+        for( size_t i = 0; i != nbytes; ++i )
+        {
+            if( p[i] != (unsigned char)(i * 7) )
+            {
+                return 0;
+            }
+        }
+
+        for( size_t i = nbytes; i != new_nbytes; ++i )
+        {
+            p[i] = (unsigned char)(i * 7);
+        }
+
+        nbytes = new_nbytes;
+    }
+
+    p = (unsigned char *)PREALLOC( p, 3000 );
+
+    for( size_t i = 0; i != 3000; ++i )
+    {
+        if( p[i] != (unsigned char)(i * 7) )
+        {
+            return 0;
+        }
+    }
+
+    PFREE( p );
+
+    return 1;
+}
+
+static int test_aligned()
+{
+    for( size_t alignment = 32; alignment <= MAX_MEDIUM; alignment *= 2 )
+    {
+        void * p = PALIGNED_ALLOC( alignment, 3000 );
+
+        if( p == NULL || ((size_t)p & (alignment - 1)) != 0 )
+        {
+            return 0;
+        }
+
+        memset( p, 0, 3000 );
+
+        PFREE( p );
+    }
+
+    // alignments above the largest class, whose blocks with PALLOC_PAGES are
+    // mapped and keep only the pages they need
+    for( size_t alignment = 2 * MAX_MEDIUM; alignment <= 16 * MAX_MEDIUM; alignment *= 2 )
+    {
+        size_t sizes[] = {3000, 3 * MAX_MEDIUM};
+
+        for( int i = 0; i != 2; ++i )
+        {
+            unsigned char * p = (unsigned char *)PALIGNED_ALLOC( alignment, sizes[i] );
+
+            if( p == NULL || ((size_t)p & (alignment - 1)) != 0 || PMALLOC_USABLE_SIZE( p ) < sizes[i] )
+            {
+                return 0;
+            }
+
+            memset( p, 0x3c, sizes[i] );
+
+            // moving the block gives up the alignment but not the contents
+            p = (unsigned char *)PREALLOC( p, 2 * sizes[i] );
+
+            if( p == NULL || p[0] != 0x3c || p[sizes[i] - 1] != 0x3c )
+            {
+                return 0;
+            }
+
+            PFREE( p );
+        }
+    }
+
+    return 1;
+}
+
+#if defined(PALLOC_THREAD)
+TEST_THREAD_DECL( thread_func, lpParam )
+{
+    unsigned char thread_id = (unsigned char)*(int *)lpParam;
+
+    unsigned char * local[16];
+
+    for( int r = 0; r != NUM_ROUNDS / 16; ++r )
+    {
+        for( int i = 0; i != 16; ++i )
+        {
+            size_t nbytes = MIN_MEDIUM << (r + i) % 7;
+
+            local[i] = (unsigned char *)PALLOC( nbytes );
+            local[i][0] = thread_id;
+            local[i][nbytes - 1] = thread_id;
+        }
+
+        for( int i = 0; i != 16; ++i )
+        {
+            size_t nbytes = MIN_MEDIUM << (r + i) % 7;
+
+            if( local[i][0] != thread_id || local[i][nbytes - 1] != thread_id )
+            {
+                TEST_THREAD_RETURN( EXIT_FAILURE );
+            }
+
+            PFREE( local[i] );
+        }
+    }
+
+    TEST_THREAD_RETURN( EXIT_SUCCESS );
+}
+
+static int test_threads()
+{
+    test_thread_t threads[NUM_THREADS];
+    int thread_ids[NUM_THREADS];
+
+    for( int i = 0; i != NUM_THREADS; ++i )
+    {
+        thread_ids[i] = i + 1;
+
+        if( test_thread_create( threads + i, &thread_func, thread_ids + i ) != 0 )
+        {
+            return 0;
+        }
+    }
+
+    int result = 1;
+
+    for( int i = 0; i != NUM_THREADS; ++i )
+    {
+        if( test_thread_join( threads[i] ) != EXIT_SUCCESS )
+        {
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+#define MIN_CACHED_MEDIUM (16 << 10)
+#define NUM_CACHED_BLOCKS 8
+
+static test_mutex_t g_hold_mutex;
+static test_mutex_t g_done_mutex;
+static int g_done;
+
+// allocates and frees a few blocks of every class from 16 KB up, then keeps
+// its thread cache alive until the main thread has measured it
+TEST_THREAD_DECL( cache_func, lpParam )
+{
+    (void)lpParam;
+
+    void * local[NUM_CACHED_BLOCKS];
+
+    for( size_t nbytes = MIN_CACHED_MEDIUM; nbytes <= MAX_MEDIUM; nbytes += nbytes / 4 )
+    {
+        for( int i = 0; i != NUM_CACHED_BLOCKS; ++i )
+        {
+            local[i] = PALLOC( nbytes );
+
+            if( local[i] == NULL )
+            {
+                TEST_THREAD_RETURN( EXIT_FAILURE );
+            }
+
+            memset( local[i], 1, nbytes );
+        }
+
+        for( int i = 0; i != NUM_CACHED_BLOCKS; ++i )
+        {
+            PFREE( local[i] );
+        }
+    }
+
+    test_mutex_lock( &g_done_mutex );
+    ++g_done;
+    test_mutex_unlock( &g_done_mutex );
+
+    test_mutex_lock( &g_hold_mutex );
+    test_mutex_unlock( &g_hold_mutex );
+
+    TEST_THREAD_RETURN( EXIT_SUCCESS );
+}
+
+// the blocks idle in the caches of live threads pin their spans past ptrim;
+// with one cached block per class the growth stays under four blocks of each
+// class per thread, where up to four cached blocks used to pin twice that
+static int test_cache_rss()
+{
+    size_t bound = 0;
+
+    for( size_t nbytes = MIN_CACHED_MEDIUM; nbytes <= MAX_MEDIUM; nbytes += nbytes / 4 )
+    {
+        bound += NUM_THREADS * 4 * nbytes;
+    }
+
+    PTRIM();
+
+    size_t rss0 = test_rss();
+
+    test_mutex_init( &g_hold_mutex );
+    test_mutex_init( &g_done_mutex );
+
+    g_done = 0;
+
+    test_mutex_lock( &g_hold_mutex );
+
+    test_thread_t threads[NUM_THREADS];
+
+    for( int i = 0; i != NUM_THREADS; ++i )
+    {
+        if( test_thread_create( threads + i, &cache_func, NULL ) != 0 )
+        {
+            return 0;
+        }
+    }
+
+    for( ;; )
+    {
+        test_mutex_lock( &g_done_mutex );
+        int done = g_done;
+        test_mutex_unlock( &g_done_mutex );
+
+        if( done == NUM_THREADS )
+        {
+            break;
+        }
+
+        test_yield();
+    }
+
+    PTRIM();
+
+    size_t rss1 = test_rss();
+
+    test_mutex_unlock( &g_hold_mutex );
+
+    int result = 1;
+
+    for( int i = 0; i != NUM_THREADS; ++i )
+    {
+        if( test_thread_join( threads[i] ) != EXIT_SUCCESS )
+        {
+            result = 0;
+        }
+    }
+
+    test_mutex_fini( &g_hold_mutex );
+    test_mutex_fini( &g_done_mutex );
+
+    size_t growth = rss1 > rss0 ? rss1 - rss0 : 0;
+
+    printf( "16-256 KB blocks cached by %d threads: %zu KB resident, bound %zu KB\n", NUM_THREADS, growth >> 10, bound >> 10 );
+
+    // the quarantine of AddressSanitizer keeps the spans ptrim frees resident
+#if !defined(__SANITIZE_ADDRESS__)
+    if( growth > bound )
+    {
+        result = 0;
+    }
+#endif
+
+    return result;
+}
+#endif
+
+static void * bench_malloc( size_t nbytes )
+{
+    return malloc( nbytes );
+}
+
+static void bench_free( void * p )
+{
+    free( p );
+}
+
+// alloc/free of 2 to 64 KB buffers with a few of them kept live
+static double bench( void * (*alloc_f)(size_t), void (*free_f)(void *) )
+{
+    rnd_state = 12345;
+
+    for( int i = 0; i != 16; ++i )
+    {
+        ptrs[i] = NULL;
+    }
+
+    double t0 = test_time();
+
+    for( int r = 0; r != NUM_ROUNDS * 16; ++r )
+    {
+        int k = r & 15;
+
+        (*free_f)( ptrs[k] );
+
+        ptrs[k] = (*alloc_f)( rnd_range( MIN_MEDIUM, 64 << 10 ) );
+
+        *(unsigned char *)ptrs[k] = (unsigned char)r;
+    }
+
+    double t1 = test_time();
+
+    for( int i = 0; i != 16; ++i )
+    {
+        (*free_f)( ptrs[i] );
+    }
+
+    return (t1 - t0) * 1e9 / (NUM_ROUNDS * 16.0);
+}
+
+int main( void )
+{
+    PINIT();
+
+    if( test_classes() == 0 || test_spans( 5000 ) == 0 || test_spans( 200000 ) == 0 || test_realloc() == 0 || test_aligned() == 0 )
+    {
+        return EXIT_FAILURE;
+    }
+
+#if defined(PALLOC_THREAD)
+    if( test_threads() == 0 || test_cache_rss() == 0 )
+    {
+        return EXIT_FAILURE;
+    }
+#endif
+
+    double palloc_ns = bench( &PALLOC, &PFREE );
+    double malloc_ns = bench( &bench_malloc, &bench_free );
+
+    printf( "2-64 KB alloc/free palloc: %6.2f ns malloc: %6.2f ns\n", palloc_ns, malloc_ns );
+
+    PFINI();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,231 @@
+#if defined(PALLOC_NUMA_LIBNUMA) && !defined(_GNU_SOURCE)
+#   define _GNU_SOURCE
+#endif
+
+#include "palloc/palloc.h"
+
+#include "test_platform.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(PALLOC_NUMA_LIBNUMA)
+#   include <numa.h>
+#   include <numaif.h>
+#endif
+
+#define NUM_BLOCKS 4096
+#define NUM_ROUNDS 50
+#define NUM_THREADS 4
+#define MAX_NODES 8
+
+static void * ptrs[NUM_THREADS][NUM_BLOCKS];
+
+static size_t block_size( int thread_id, int i )
+{
+    return (size_t)16 << (thread_id + i) % 10;
+}
+
+// fills the slot of the thread with blocks
+TEST_THREAD_DECL( alloc_func, lpParam )
+{
+    int thread_id = *(int *)lpParam;
+
+    for( int i = 0; i != NUM_BLOCKS; ++i )
+    {
+        size_t nbytes = block_size( thread_id, i );
+
+        unsigned char * p = (unsigned char *)PALLOC( nbytes );
+
+        if( p == NULL )
+        {
+            TEST_THREAD_RETURN( EXIT_FAILURE );
+        }
+
+        memset( p, thread_id + 1, nbytes );
+
+        ptrs[thread_id][i] = p;
+    }
+
+    TEST_THREAD_RETURN( EXIT_SUCCESS );
+}
+
+// checks and frees the blocks of the neighbour, half of them singly and the
+// rest in bulk
+TEST_THREAD_DECL( free_func, lpParam )
+{
+    int other = (*(int *)lpParam + 1) % NUM_THREADS;
+
+    size_t count = 0;
+
+    for( int i = 0; i != NUM_BLOCKS; ++i )
+    {
+        size_t nbytes = block_size( other, i );
+
+        unsigned char * p = (unsigned char *)ptrs[other][i];
+
+        if( p[0] != (unsigned char)(other + 1) || p[nbytes - 1] != (unsigned char)(other + 1) )
+        {
+            TEST_THREAD_RETURN( EXIT_FAILURE );
+        }
+
+        if( (i & 1) != 0 )
+        {
+            PFREE( p );
+        }
+        else
+        {
+            ptrs[other][count++] = p;
+        }
+    }
+
+    PFREE_BULK( ptrs[other], count );
+
+    TEST_THREAD_RETURN( EXIT_SUCCESS );
+}
+
+static int run_threads( test_thread_result_t (TEST_THREAD_CALL * f)(void *), int count )
+{
+    test_thread_t threads[MAX_NODES];
+    int thread_ids[MAX_NODES];
+
+    for( int i = 0; i != count; ++i )
+    {
+        thread_ids[i] = i;
+
+        if( test_thread_create( threads + i, f, thread_ids + i ) != 0 )
+        {
+            return 0;
+        }
+    }
+
+    int result = 1;
+
+    for( int i = 0; i != count; ++i )
+    {
+        if( test_thread_join( threads[i] ) != EXIT_SUCCESS )
+        {
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+// every block is freed by another thread than the one that allocated it, so
+// it goes back through the shards of other threads and, on a machine with
+// several nodes, of other node groups
+static int test_cross()
+{
+    for( int r = 0; r != NUM_ROUNDS; ++r )
+    {
+        if( run_threads( &alloc_func, NUM_THREADS ) == 0 || run_threads( &free_func, NUM_THREADS ) == 0 )
+        {
+            return 0;
+        }
+    }
+
+    // all the blocks are free again, so ptrim releases the spans
+    if( PTRIM() == 0 )
+    {
+        return 0;
+    }
+
+    return 1;
+}
+
+#if defined(PALLOC_NUMA_LIBNUMA)
+static int g_misplaced[MAX_NODES];
+
+// a thread pinned to a node gets blocks whose pages are on that node
+TEST_THREAD_DECL( node_func, lpParam )
+{
+    int node = *(int *)lpParam;
+
+    if( numa_run_on_node( node ) != 0 )
+    {
+        TEST_THREAD_RETURN( EXIT_FAILURE );
+    }
+
+    void * local[64];
+
+    for( int i = 0; i != 64; ++i )
+    {
+        size_t nbytes = (size_t)4096 << i % 6;
+
+        local[i] = PALLOC( nbytes );
+
+        if( local[i] == NULL )
+        {
+            TEST_THREAD_RETURN( EXIT_FAILURE );
+        }
+
+        memset( local[i], 1, nbytes );
+
+        int page_node = -1;
+
+        if( get_mempolicy( &page_node, NULL, 0, local[i], MPOL_F_NODE | MPOL_F_ADDR ) != 0 || page_node != node )
+        {
+            ++g_misplaced[node];
+        }
+    }
+
+    for( int i = 0; i != 64; ++i )
+    {
+        PFREE( local[i] );
+    }
+
+    TEST_THREAD_RETURN( EXIT_SUCCESS );
+}
+
+static int test_placement()
+{
+    if( numa_available() < 0 )
+    {
+        return 1;
+    }
+
+    int nodes = numa_max_node() + 1;
+
+    nodes = nodes < MAX_NODES ? nodes : MAX_NODES;
+
+    int result = run_threads( &node_func, nodes );
+
+    for( int i = 0; i != nodes; ++i )
+    {
+        printf( "node %d: %d of 64 blocks misplaced\n", i, g_misplaced[i] );
+
+        // the preferred node may be short of memory, most blocks are local;
+        // with more nodes than the two groups of the default PALLOC_NUMA_BITS
+        // spans have no preferred node
+        if( nodes <= 2 && g_misplaced[i] > 32 )
+        {
+            result = 0;
+        }
+    }
+
+    return result;
+}
+#endif
+
+int main( void )
+{
+    PINIT();
+
+    if( test_cross() == 0 )
+    {
+        return EXIT_FAILURE;
+    }
+
+#if defined(PALLOC_NUMA_LIBNUMA)
+    if( test_placement() == 0 )
+    {
+        return EXIT_FAILURE;
+    }
+#endif
+
+    PFINI();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,76 @@
+#include "palloc/palloc.h"
+
+#include "test_platform.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// sizes so close to SIZE_MAX that the header, alignment padding or page
+// rounding of a large block would wrap them
+static int test_huge( size_t nbytes )
+{
+    if( PALLOC( nbytes ) != NULL || PCALLOC( 1, nbytes ) != NULL || PALIGNED_ALLOC( 64, nbytes ) != NULL || PALIGNED_ALLOC( 1 << 20, nbytes ) != NULL )
+    {
+        return 0;
+    }
+
+    size_t actual = 1;
+
+    if( PALLOC_SIZED( nbytes, &actual ) != NULL || actual != 0 )
+    {
+        return 0;
+    }
+
+    // a failed realloc leaves the block as it was, from a small class as well
+    // as a large one
+    size_t sizes[] = {100, 1 << 20};
+
+    for( int i = 0; i != 2; ++i )
+    {
+        unsigned char * p = (unsigned char *)PALLOC( sizes[i] );
+
+        if( p == NULL )
+        {
+            return 0;
+        }
+
+        memset( p, 0x5a, sizes[i] );
+
+        if( PREALLOC( p, nbytes ) != NULL )
+        {
+            return 0;
+        }
+
+        if( p[0] != 0x5a || p[sizes[i] - 1] != 0x5a )
+        {
+            return 0;
+        }
+
+        PFREE( p );
+    }
+
+    return 1;
+}
+
+int main( void )
+{
+    PINIT();
+
+    // repeated, since a wrapped size used to corrupt the heap of the C
+    // library only after a few calls
+    for( int r = 0; r != 8; ++r )
+    {
+        if( test_huge( SIZE_MAX ) == 0 || test_huge( SIZE_MAX - 8 ) == 0 || test_huge( SIZE_MAX - 16 ) == 0 || test_huge( SIZE_MAX - 20 ) == 0 )
+        {
+            printf( "a size near SIZE_MAX did not fail\n" );
+
+            return EXIT_FAILURE;
+        }
+    }
+
+    PFINI();
+
+    return EXIT_SUCCESS;
+}
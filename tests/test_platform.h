@@ -0,0 +1,181 @@
+#ifndef TEST_PLATFORM_H_
+#define TEST_PLATFORM_H_
+
+#include <stddef.h>
+
+#if defined(_WIN32)
+#   define WIN32_LEAN_AND_MEAN
+#   include <Windows.h>
+#   include <psapi.h>
+
+typedef HANDLE test_thread_t;
+typedef DWORD test_thread_result_t;
+
+#   define TEST_THREAD_CALL WINAPI
+
+#   define TEST_THREAD_DECL(F, A) static test_thread_result_t TEST_THREAD_CALL F( LPVOID A )
+#   define TEST_THREAD_RETURN(V) return (test_thread_result_t)(V)
+
+static inline int test_thread_create( test_thread_t * t, test_thread_result_t (TEST_THREAD_CALL * f)(LPVOID), void * arg )
+{
+    *t = CreateThread( NULL, 0, f, arg, 0, NULL );
+
+    return *t == NULL ? 1 : 0;
+}
+
+static inline int test_thread_join( test_thread_t t )
+{
+    WaitForSingleObject( t, INFINITE );
+
+    DWORD exit_code;
+    GetExitCodeThread( t, &exit_code );
+
+    CloseHandle( t );
+
+    return (int)exit_code;
+}
+
+typedef CRITICAL_SECTION test_mutex_t;
+
+static inline void test_mutex_init( test_mutex_t * m )
+{
+    InitializeCriticalSection( m );
+}
+
+static inline void test_mutex_fini( test_mutex_t * m )
+{
+    DeleteCriticalSection( m );
+}
+
+static inline void test_mutex_lock( test_mutex_t * m )
+{
+    EnterCriticalSection( m );
+}
+
+static inline void test_mutex_unlock( test_mutex_t * m )
+{
+    LeaveCriticalSection( m );
+}
+
+static inline void test_yield()
+{
+    SwitchToThread();
+}
+
+// resident set size of the process in bytes
+static inline size_t test_rss()
+{
+    PROCESS_MEMORY_COUNTERS pmc;
+
+    if( GetProcessMemoryInfo( GetCurrentProcess(), &pmc, sizeof( pmc ) ) == 0 )
+    {
+        return 0;
+    }
+
+    return (size_t)pmc.WorkingSetSize;
+}
+
+static inline double test_time()
+{
+    LARGE_INTEGER f;
+    QueryPerformanceFrequency( &f );
+
+    LARGE_INTEGER c;
+    QueryPerformanceCounter( &c );
+
+    return (double)c.QuadPart / (double)f.QuadPart;
+}
+#else
+#   ifndef _POSIX_C_SOURCE
+#       define _POSIX_C_SOURCE 200112L
+#   endif
+
+#   include <pthread.h>
+#   include <sched.h>
+#   include <stdio.h>
+#   include <time.h>
+#   include <unistd.h>
+
+typedef pthread_t test_thread_t;
+typedef void * test_thread_result_t;
+
+#   define TEST_THREAD_CALL
+
+#   define TEST_THREAD_DECL(F, A) static test_thread_result_t F( void * A )
+#   define TEST_THREAD_RETURN(V) return (test_thread_result_t)(size_t)(V)
+
+static inline int test_thread_create( test_thread_t * t, test_thread_result_t (*f)(void *), void * arg )
+{
+    return pthread_create( t, NULL, f, arg ) == 0 ? 0 : 1;
+}
+
+static inline int test_thread_join( test_thread_t t )
+{
+    void * exit_code;
+    pthread_join( t, &exit_code );
+
+    return (int)(size_t)exit_code;
+}
+
+typedef pthread_mutex_t test_mutex_t;
+
+static inline void test_mutex_init( test_mutex_t * m )
+{
+    pthread_mutex_init( m, NULL );
+}
+
+static inline void test_mutex_fini( test_mutex_t * m )
+{
+    pthread_mutex_destroy( m );
+}
+
+static inline void test_mutex_lock( test_mutex_t * m )
+{
+    pthread_mutex_lock( m );
+}
+
+static inline void test_mutex_unlock( test_mutex_t * m )
+{
+    pthread_mutex_unlock( m );
+}
+
+static inline void test_yield()
+{
+    sched_yield();
+}
+
+// resident set size of the process in bytes, 0 where /proc is not available
+static inline size_t test_rss()
+{
+    FILE * f = fopen( "/proc/self/statm", "r" );
+
+    if( f == NULL )
+    {
+        return 0;
+    }
+
+    unsigned long size = 0;
+    unsigned long resident = 0;
+
+    int n = fscanf( f, "%lu %lu", &size, &resident );
+
+    fclose( f );
+
+    if( n != 2 )
+    {
+        return 0;
+    }
+
+    return (size_t)resident * (size_t)sysconf( _SC_PAGESIZE );
+}
+
+static inline double test_time()
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+#endif
+
+#endif // TEST_PLATFORM_H_
@@ -0,0 +1,212 @@
+#include "test_platform.h"
+
+#include "palloc/palloc.h"
+#include "palloc/ppool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_OBJECTS 1000
+#define NUM_ROUNDS 2000
+#define NUM_THREADS 4
+
+typedef struct node_t
+{
+    struct node_t * left;
+    struct node_t * right;
+    int key;
+    int value;
+} node_t;
+
+typedef struct vec_t
+{
+    float v[3];
+} vec_t;
+
+PPOOL_DECLARE( node_pool, node_t, 8, 256 )
+PPOOL_DECLARE( vec_pool, vec_t, 64, 64 )
+
+static node_t * nodes[NUM_OBJECTS];
+
+static int test_pool()
+{
+    for( int r = 0; r != 4; ++r )
+    {
+        for( int i = 0; i != NUM_OBJECTS; ++i )
+        {
+            node_t * n = node_pool_alloc();
+
+            if( n == NULL || ((size_t)n & 7) != 0 )
+            {
+                return 0;
+            }
+
+            n->left = NULL;
+            n->right = NULL;
+            n->key = i;
+            n->value = r;
+
+            nodes[i] = n;
+        }
+
+        for( int i = 0; i != NUM_OBJECTS; ++i )
+        {
+            if( nodes[i]->key != i || nodes[i]->value != r )
+            {
+                return 0;
+            }
+        }
+
+        for( int i = 0; i != NUM_OBJECTS; ++i )
+        {
+            node_pool_free( nodes[i] );
+        }
+    }
+
+    // a freed block is the next one handed out
+    node_t * a = node_pool_alloc();
+    node_pool_free( a );
+
+    if( node_pool_alloc() != a )
+    {
+        return 0;
+    }
+
+    node_pool_free( a );
+
+    for( int i = 0; i != 100; ++i )
+    {
+        vec_t * v = vec_pool_alloc();
+
+        if( v == NULL || ((size_t)v & 63) != 0 )
+        {
+            return 0;
+        }
+
+        v->v[0] = (float)i;
+    }
+
+    return 1;
+}
+
+#if defined(PALLOC_THREAD)
+TEST_THREAD_DECL( thread_func, lpParam )
+{
+    int thread_id = *(int *)lpParam;
+
+    node_t * local[64];
+
+    for( int r = 0; r != NUM_ROUNDS; ++r )
+    {
+        for( int i = 0; i != 64; ++i )
+        {
+            local[i] = node_pool_alloc();
+            local[i]->key = thread_id;
+        }
+
+        for( int i = 0; i != 64; ++i )
+        {
+            if( local[i]->key != thread_id )
+            {
+                TEST_THREAD_RETURN( EXIT_FAILURE );
+            }
+
+            node_pool_free( local[i] );
+        }
+    }
+
+    node_pool_flush();
+
+    TEST_THREAD_RETURN( EXIT_SUCCESS );
+}
+
+static int test_threads()
+{
+    test_thread_t threads[NUM_THREADS];
+    int thread_ids[NUM_THREADS];
+
+    for( int i = 0; i != NUM_THREADS; ++i )
+    {
+        thread_ids[i] = i + 1;
+
+        if( test_thread_create( threads + i, &thread_func, thread_ids + i ) != 0 )
+        {
+            return 0;
+        }
+    }
+
+    int result = 1;
+
+    for( int i = 0; i != NUM_THREADS; ++i )
+    {
+        if( test_thread_join( threads[i] ) != EXIT_SUCCESS )
+        {
+            result = 0;
+        }
+    }
+
+    return result;
+}
+#endif
+
+static double bench( int use_pool )
+{
+    double t0 = test_time();
+
+    for( int r = 0; r != NUM_ROUNDS; ++r )
+    {
+        for( int i = 0; i != NUM_OBJECTS; ++i )
+        {
+            nodes[i] = use_pool ? node_pool_alloc() : (node_t *)PALLOC( sizeof( node_t ) );
+        }
+
+        for( int i = 0; i != NUM_OBJECTS; ++i )
+        {
+            if( use_pool )
+            {
+                node_pool_free( nodes[i] );
+            }
+            else
+            {
+                PFREE( nodes[i] );
+            }
+        }
+    }
+
+    double t1 = test_time();
+
+    return (t1 - t0) * 1e9 / ((double)NUM_ROUNDS * NUM_OBJECTS);
+}
+
+int main( void )
+{
+    PINIT();
+
+    node_pool_init();
+    vec_pool_init();
+
+    if( test_pool() == 0 )
+    {
+        return EXIT_FAILURE;
+    }
+
+#if defined(PALLOC_THREAD)
+    if( test_threads() == 0 )
+    {
+        return EXIT_FAILURE;
+    }
+#endif
+
+    double palloc_ns = bench( 0 );
+    double pool_ns = bench( 1 );
+
+    printf( "palloc/pfree: %6.2f ns pool alloc/free: %6.2f ns\n", palloc_ns, pool_ns );
+
+    vec_pool_fini();
+    node_pool_fini();
+
+    PFINI();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,339 @@
+// Runs with the interposing library in LD_PRELOAD and only calls the C
+// allocation functions; the usable sizes tell palloc blocks from those of the
+// C library.
+#if !defined(_GNU_SOURCE)
+#   define _GNU_SOURCE
+#endif
+
+#include "test_platform.h"
+
+#include <errno.h>
+#include <malloc.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(PALLOC_THREAD)
+#   include <sys/wait.h>
+#   include <unistd.h>
+#endif
+
+#define NUM_THREADS 4
+#define NUM_FORKS 200
+#define NUM_ROUNDS 20000
+
+static int test_interposed()
+{
+    // 70 bytes get the 80 byte class and 3000 the 3072 byte one
+    void * p = malloc( 70 );
+    void * q = malloc( 3000 );
+
+    if( p == NULL || q == NULL || malloc_usable_size( p ) != 80 || malloc_usable_size( q ) != 3072 )
+    {
+        return 0;
+    }
+
+    free( p );
+    free( q );
+
+    // allocations made inside the C library go through palloc as well
+    char * s = strdup( "palloc preload, a string of forty bytes" );
+
+    if( s == NULL || malloc_usable_size( s ) != 48 )
+    {
+        return 0;
+    }
+
+    free( s );
+
+    return 1;
+}
+
+static int test_functions()
+{
+    unsigned char * z = (unsigned char *)calloc( 1000, 3 );
+
+    if( z == NULL )
+    {
+        return 0;
+    }
+
+    for( size_t i = 0; i != 3000; ++i )
+    {
+        if( z[i] != 0 )
+        {
+            return 0;
+        }
+    }
+
+    free( z );
+
+    // volatile keeps the compiler from rejecting the overflowing product
+    volatile size_t count = SIZE_MAX / 2;
+
+    errno = 0;
+
+    if( calloc( count, 4 ) != NULL || errno != ENOMEM )
+    {
+        return 0;
+    }
+
+    // sizes that would wrap once palloc adds its header fail like in the C
+    // library
+    volatile size_t huge[] = {SIZE_MAX, SIZE_MAX - 16};
+
+    for( int i = 0; i != 2; ++i )
+    {
+        errno = 0;
+
+        if( malloc( huge[i] ) != NULL || errno != ENOMEM || calloc( 1, huge[i] ) != NULL || aligned_alloc( 64, huge[i] ) != NULL )
+        {
+            return 0;
+        }
+
+        void * h = malloc( 100 );
+
+        if( h == NULL || realloc( h, huge[i] ) != NULL )
+        {
+            return 0;
+        }
+
+        free( h );
+    }
+
+    unsigned char * r = NULL;
+
+    for( size_t nbytes = 1; nbytes <= (1 << 20); nbytes = nbytes * 3 / 2 + 1 )
+    {
+        size_t old_nbytes = nbytes * 2 / 3;
+
+        r = (unsigned char *)realloc( r, nbytes );
+
+        if( r == NULL )
+        {
+            return 0;
+        }
+
+        for( size_t i = 0; i < old_nbytes; ++i )
+        {
+            if( r[i] != (unsigned char)i )
+            {
+                return 0;
+            }
+        }
+
+        for( size_t i = 0; i != nbytes; ++i )
+        {
+            r[i] = (unsigned char)i;
+        }
+    }
+
+    free( r );
+
+    for( size_t alignment = sizeof( void * ); alignment <= (1 << 16); alignment *= 2 )
+    {
+        void * a = NULL;
+
+        if( posix_memalign( &a, alignment, 100 ) != 0 || ((uintptr_t)a & (alignment - 1)) != 0 )
+        {
+            return 0;
+        }
+
+        free( a );
+
+        a = aligned_alloc( alignment, 4 * alignment );
+
+        if( a == NULL || ((uintptr_t)a & (alignment - 1)) != 0 )
+        {
+            return 0;
+        }
+
+        memset( a, 1, 4 * alignment );
+
+        free( a );
+    }
+
+    void * a = NULL;
+
+    if( posix_memalign( &a, 24, 100 ) != EINVAL )
+    {
+        return 0;
+    }
+
+    return 1;
+}
+
+#if defined(PALLOC_THREAD)
+TEST_THREAD_DECL( thread_func, lpParam )
+{
+    unsigned char thread_id = (unsigned char)*(int *)lpParam;
+
+    unsigned char * local[64];
+
+    for( int r = 0; r != NUM_ROUNDS / 64; ++r )
+    {
+        for( int i = 0; i != 64; ++i )
+        {
+            size_t nbytes = (size_t)1 << (i + r) % 18;
+
+            local[i] = (unsigned char *)malloc( nbytes );
+            local[i][0] = thread_id;
+        }
+
+        for( int i = 0; i != 64; ++i )
+        {
+            if( local[i][0] != thread_id )
+            {
+                TEST_THREAD_RETURN( EXIT_FAILURE );
+            }
+
+            free( local[i] );
+        }
+    }
+
+    TEST_THREAD_RETURN( EXIT_SUCCESS );
+}
+
+static int test_threads()
+{
+    test_thread_t threads[NUM_THREADS];
+    int thread_ids[NUM_THREADS];
+
+    for( int i = 0; i != NUM_THREADS; ++i )
+    {
+        thread_ids[i] = i + 1;
+
+        if( test_thread_create( threads + i, &thread_func, thread_ids + i ) != 0 )
+        {
+            return 0;
+        }
+    }
+
+    int result = 1;
+
+    for( int i = 0; i != NUM_THREADS; ++i )
+    {
+        if( test_thread_join( threads[i] ) != EXIT_SUCCESS )
+        {
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+static volatile int g_forking = 1;
+
+TEST_THREAD_DECL( load_func, lpParam )
+{
+    (void)lpParam;
+
+    void * local[512];
+
+    // bursts larger than a thread cache, so refills and spills keep taking
+    // the shared locks
+    for( unsigned int r = 0; g_forking != 0; ++r )
+    {
+        size_t nbytes = (size_t)16 << r % 15;
+
+        for( int k = 0; k != 512; ++k )
+        {
+            local[k] = malloc( nbytes );
+        }
+
+        for( int k = 0; k != 512; ++k )
+        {
+            free( local[k] );
+        }
+    }
+
+    TEST_THREAD_RETURN( EXIT_SUCCESS );
+}
+
+// forks while other threads allocate, children that find a lock held by a
+// thread that does not exist in them hang until the alarm kills them
+static int test_fork()
+{
+    test_thread_t threads[NUM_THREADS];
+
+    for( int i = 0; i != NUM_THREADS; ++i )
+    {
+        if( test_thread_create( threads + i, &load_func, NULL ) != 0 )
+        {
+            return 0;
+        }
+    }
+
+    int result = 1;
+
+    for( int f = 0; f != NUM_FORKS && result != 0; ++f )
+    {
+        pid_t pid = fork();
+
+        if( pid == 0 )
+        {
+            alarm( 10 );
+
+            void * local[256];
+
+            for( int i = 0; i != 256; ++i )
+            {
+                local[i] = malloc( (size_t)16 << i % 15 );
+            }
+
+            for( int i = 0; i != 256; ++i )
+            {
+                free( local[i] );
+            }
+
+            _exit( EXIT_SUCCESS );
+        }
+
+        int status = 0;
+
+        if( pid < 0 || waitpid( pid, &status, 0 ) != pid || WIFEXITED( status ) == 0 || WEXITSTATUS( status ) != EXIT_SUCCESS )
+        {
+            printf( "child %d of fork %d did not finish\n", (int)pid, f );
+
+            result = 0;
+        }
+    }
+
+    g_forking = 0;
+
+    for( int i = 0; i != NUM_THREADS; ++i )
+    {
+        if( test_thread_join( threads[i] ) != EXIT_SUCCESS )
+        {
+            result = 0;
+        }
+    }
+
+    return result;
+}
+#endif
+
+int main( void )
+{
+    if( test_interposed() == 0 )
+    {
+        printf( "palloc is not interposed, run with LD_PRELOAD\n" );
+
+        return EXIT_FAILURE;
+    }
+
+    if( test_functions() == 0 )
+    {
+        return EXIT_FAILURE;
+    }
+
+#if defined(PALLOC_THREAD)
+    if( test_threads() == 0 || test_fork() == 0 )
+    {
+        return EXIT_FAILURE;
+    }
+#endif
+
+    return EXIT_SUCCESS;
+}
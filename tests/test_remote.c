@@ -0,0 +1,216 @@
+#include "palloc/palloc.h"
+
+#include "test_platform.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_MESSAGES 1000000
+#define NUM_BATCH 32
+#define MAX_QUEUED 2048
+#define MAX_PAIRS 4
+
+// A producer allocates messages and hands them to its consumer, which checks
+// and frees them, so every free is of a block another thread allocated.
+typedef struct message_t
+{
+    struct message_t * next;
+    unsigned int producer;
+    unsigned int seq;
+    unsigned char payload[48];
+} message_t;
+
+typedef struct
+{
+    test_mutex_t mutex;
+    message_t * head;
+    size_t count;
+    int done;
+} channel_t;
+
+typedef struct
+{
+    channel_t * channel;
+    unsigned int producer;
+} pair_arg_t;
+
+TEST_THREAD_DECL( producer_func, lpParam )
+{
+    pair_arg_t * arg = (pair_arg_t *)lpParam;
+    channel_t * ch = arg->channel;
+
+    for( unsigned int seq = 0; seq != NUM_MESSAGES; )
+    {
+        test_mutex_lock( &ch->mutex );
+        size_t queued = ch->count;
+        test_mutex_unlock( &ch->mutex );
+
+        if( queued >= MAX_QUEUED )
+        {
+            test_yield();
+
+            continue;
+        }
+
+        message_t * first = NULL;
+        message_t * last = NULL;
+
+        unsigned int n = 0;
+
+        for( ; n != NUM_BATCH && seq != NUM_MESSAGES; ++n, ++seq )
+        {
+            message_t * m = (message_t *)PALLOC( sizeof( message_t ) );
+
+            if( m == NULL )
+            {
+                TEST_THREAD_RETURN( EXIT_FAILURE );
+            }
+
+            m->producer = arg->producer;
+            m->seq = seq;
+            memset( m->payload, (int)(seq & 0xff), sizeof( m->payload ) );
+
+            m->next = first;
+            first = m;
+
+            if( last == NULL )
+            {
+                last = m;
+            }
+        }
+
+        test_mutex_lock( &ch->mutex );
+        last->next = ch->head;
+        ch->head = first;
+        ch->count += n;
+        test_mutex_unlock( &ch->mutex );
+    }
+
+    test_mutex_lock( &ch->mutex );
+    ch->done = 1;
+    test_mutex_unlock( &ch->mutex );
+
+    TEST_THREAD_RETURN( EXIT_SUCCESS );
+}
+
+TEST_THREAD_DECL( consumer_func, lpParam )
+{
+    pair_arg_t * arg = (pair_arg_t *)lpParam;
+    channel_t * ch = arg->channel;
+
+    for( ;; )
+    {
+        test_mutex_lock( &ch->mutex );
+        message_t * m = ch->head;
+        int done = ch->done;
+        ch->head = NULL;
+        ch->count = 0;
+        test_mutex_unlock( &ch->mutex );
+
+        if( m == NULL )
+        {
+            if( done == 1 )
+            {
+                break;
+            }
+
+            test_yield();
+
+            continue;
+        }
+
+        while( m != NULL )
+        {
+            message_t * next = m->next;
+
+            if( m->producer != arg->producer || m->payload[47] != (unsigned char)(m->seq & 0xff) )
+            {
+                TEST_THREAD_RETURN( EXIT_FAILURE );
+            }
+
+            PFREE( m );
+
+            m = next;
+        }
+    }
+
+    TEST_THREAD_RETURN( EXIT_SUCCESS );
+}
+
+static int run( int num_pairs, double * ops )
+{
+    channel_t channels[MAX_PAIRS];
+    pair_arg_t args[MAX_PAIRS];
+    test_thread_t threads[2 * MAX_PAIRS];
+
+    for( int i = 0; i != num_pairs; ++i )
+    {
+        test_mutex_init( &channels[i].mutex );
+        channels[i].head = NULL;
+        channels[i].count = 0;
+        channels[i].done = 0;
+
+        args[i].channel = channels + i;
+        args[i].producer = (unsigned int)i;
+    }
+
+    double t0 = test_time();
+
+    for( int i = 0; i != num_pairs; ++i )
+    {
+        if( test_thread_create( threads + 2 * i, &producer_func, args + i ) != 0 ||
+            test_thread_create( threads + 2 * i + 1, &consumer_func, args + i ) != 0 )
+        {
+            return 0;
+        }
+    }
+
+    int ok = 1;
+
+    for( int i = 0; i != 2 * num_pairs; ++i )
+    {
+        if( test_thread_join( threads[i] ) != EXIT_SUCCESS )
+        {
+            ok = 0;
+        }
+    }
+
+    double t1 = test_time();
+
+    *ops = 2.0 * NUM_MESSAGES * num_pairs / (t1 - t0);
+
+    for( int i = 0; i != num_pairs; ++i )
+    {
+        test_mutex_fini( &channels[i].mutex );
+    }
+
+    return ok;
+}
+
+int main( void )
+{
+    PINIT();
+
+    for( int num_pairs = 1; num_pairs <= MAX_PAIRS; num_pairs *= 2 )
+    {
+        double ops;
+
+        if( run( num_pairs, &ops ) == 0 )
+        {
+            return EXIT_FAILURE;
+        }
+
+        printf( "pairs: %d ops/sec: %12.0f\n", num_pairs, ops );
+    }
+
+    // every message went back to a free list, none is stranded on one
+    if( PTRIM() == 0 || PTRIM() != 0 )
+    {
+        return EXIT_FAILURE;
+    }
+
+    PFINI();
+
+    return EXIT_SUCCESS;
+}
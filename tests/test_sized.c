@@ -0,0 +1,181 @@
+#include "palloc/palloc.h"
+
+#include "test_platform.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_BLOCKS 4096
+#define NUM_ROUNDS 1000
+
+static void * ptrs[NUM_BLOCKS];
+
+static size_t block_size( int i )
+{
+    size_t nbytes = (size_t)(i * 7919 % 2100);
+
+    return nbytes;
+}
+
+static int test_sized()
+{
+    for( int r = 0; r != 4; ++r )
+    {
+        for( int i = 0; i != NUM_BLOCKS; ++i )
+        {
+            size_t nbytes = block_size( i + r );
+
+            ptrs[i] = PALLOC( nbytes );
+
+            if( ptrs[i] == NULL )
+            {
+                return 0;
+            }
+
+            memset( ptrs[i], i & 0xff, nbytes );
+        }
+
+        for( int i = 0; i != NUM_BLOCKS; ++i )
+        {
+            PFREE_SIZED( ptrs[i], block_size( i + r ) );
+        }
+    }
+
+    void * large = PALLOC( 100000 );
+
+    PFREE_SIZED( large, 100000 );
+    PFREE_SIZED( NULL, 16 );
+
+    // blocks freed by size go back to the class they were taken from
+    void * a = PALLOC( 100 );
+    PFREE_SIZED( a, 100 );
+
+    void * b = PALLOC( 100 );
+    PFREE( b );
+
+    return a == b;
+}
+
+// the actual size is the usable size of the block, all of it can be written
+// and either size frees the block
+static int test_actual()
+{
+    for( size_t nbytes = 0; nbytes <= (1 << 20); nbytes += nbytes / 6 + 1 )
+    {
+        size_t actual = 0;
+
+        unsigned char * p = (unsigned char *)PALLOC_SIZED( nbytes, &actual );
+
+        if( p == NULL || actual < nbytes || actual != PMALLOC_USABLE_SIZE( p ) )
+        {
+            return 0;
+        }
+
+        memset( p, 0x3c, actual );
+
+        PFREE_SIZED( p, (nbytes & 1) != 0 ? nbytes : actual );
+    }
+
+    // 70 bytes get the 80 byte class
+    size_t actual = 0;
+    void * p = PALLOC_SIZED( 70, &actual );
+
+    PFREE( p );
+
+    return actual == 80;
+}
+
+// Appends bytes one at a time to a buffer that grows by half its capacity
+// and returns how many times it was reallocated, with the capacity taken
+// from the requested or from the actual size.
+static size_t append( int use_actual )
+{
+    size_t capacity = 24;
+    size_t actual = 0;
+
+    unsigned char * b = (unsigned char *)PALLOC_SIZED( capacity, &actual );
+    capacity = use_actual != 0 ? actual : capacity;
+
+    size_t reallocs = 0;
+
+    for( size_t i = 0; i != (1 << 20); ++i )
+    {
+        if( i == capacity )
+        {
+            capacity += capacity / 2;
+
+            b = (unsigned char *)PREALLOC( b, capacity );
+            capacity = use_actual != 0 ? PMALLOC_USABLE_SIZE( b ) : capacity;
+
+            ++reallocs;
+        }
+
+        b[i] = (unsigned char)i;
+    }
+
+    PFREE( b );
+
+    return reallocs;
+}
+
+static double bench( int sized )
+{
+    double t0 = test_time();
+
+    for( int r = 0; r != NUM_ROUNDS; ++r )
+    {
+        for( int i = 0; i != NUM_BLOCKS; ++i )
+        {
+            ptrs[i] = PALLOC( 48 );
+        }
+
+        if( sized == 1 )
+        {
+            for( int i = 0; i != NUM_BLOCKS; ++i )
+            {
+                PFREE_SIZED( ptrs[i], 48 );
+            }
+        }
+        else
+        {
+            for( int i = 0; i != NUM_BLOCKS; ++i )
+            {
+                PFREE( ptrs[i] );
+            }
+        }
+    }
+
+    double t1 = test_time();
+
+    return (t1 - t0) * 1e9 / ((double)NUM_ROUNDS * NUM_BLOCKS);
+}
+
+int main( void )
+{
+    PINIT();
+
+    if( test_sized() == 0 || test_actual() == 0 )
+    {
+        return EXIT_FAILURE;
+    }
+
+    size_t requested_reallocs = append( 0 );
+    size_t actual_reallocs = append( 1 );
+
+    printf( "1 MB appended, reallocs with requested capacity: %zu actual capacity: %zu\n", requested_reallocs, actual_reallocs );
+
+    if( actual_reallocs > requested_reallocs )
+    {
+        return EXIT_FAILURE;
+    }
+
+    double free_ns = bench( 0 );
+    double sized_ns = bench( 1 );
+
+    printf( "pfree: %6.2f ns pfree_sized: %6.2f ns per alloc/free\n", free_ns, sized_ns );
+
+    PFINI();
+
+    return EXIT_SUCCESS;
+}
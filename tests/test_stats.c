@@ -0,0 +1,177 @@
+#include "palloc/palloc.h"
+
+#include "test_platform.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_BLOCKS 1000
+#define NUM_LARGE 10
+#define NUM_THREADS 4
+#define NUM_ROUNDS 10000
+
+static void * ptrs[NUM_BLOCKS];
+static void * large_ptrs[NUM_LARGE];
+
+#if defined(PALLOC_THREAD)
+TEST_THREAD_DECL( thread_func, lpParam )
+{
+    (void)lpParam;
+
+    for( int r = 0; r != NUM_ROUNDS; ++r )
+    {
+        void * p = PALLOC( 100 );
+
+        if( p == NULL )
+        {
+            TEST_THREAD_RETURN( EXIT_FAILURE );
+        }
+
+        PFREE( p );
+    }
+
+    TEST_THREAD_RETURN( EXIT_SUCCESS );
+}
+
+static int test_threads()
+{
+    pstats_t s0 = PSTATS();
+
+    test_thread_t threads[NUM_THREADS];
+
+    for( int i = 0; i != NUM_THREADS; ++i )
+    {
+        if( test_thread_create( threads + i, &thread_func, NULL ) != 0 )
+        {
+            return 0;
+        }
+    }
+
+    int result = 1;
+
+    for( int i = 0; i != NUM_THREADS; ++i )
+    {
+        if( test_thread_join( threads[i] ) != EXIT_SUCCESS )
+        {
+            result = 0;
+        }
+    }
+
+    pstats_t s1 = PSTATS();
+
+    // 100 bytes is the 112 byte class
+    if( s1.classes[6].allocs - s0.classes[6].allocs != (size_t)NUM_THREADS * NUM_ROUNDS )
+    {
+        return 0;
+    }
+
+    if( s1.classes[6].frees - s0.classes[6].frees != (size_t)NUM_THREADS * NUM_ROUNDS )
+    {
+        return 0;
+    }
+
+    return result;
+}
+#endif
+
+int main( void )
+{
+    PINIT();
+
+    for( int i = 0; i != NUM_BLOCKS; ++i )
+    {
+        ptrs[i] = PALLOC( 24 );
+    }
+
+    for( int i = 0; i != NUM_LARGE; ++i )
+    {
+        large_ptrs[i] = PALLOC( 300000 );
+    }
+
+    pstats_t s = PSTATS();
+
+    // 24 bytes is the 32 byte class
+    if( s.classes[1].nbytes != 32 || s.classes[1].allocs != NUM_BLOCKS || s.classes[1].live != NUM_BLOCKS )
+    {
+        return EXIT_FAILURE;
+    }
+
+    if( s.classes[1].requested != (size_t)NUM_BLOCKS * 24 || s.classes[1].chunks != 1 || s.classes[1].refills == 0 )
+    {
+        return EXIT_FAILURE;
+    }
+
+    if( s.large_allocs != NUM_LARGE || s.large_live != NUM_LARGE || s.large_bytes < (size_t)NUM_LARGE * 300000 )
+    {
+        return EXIT_FAILURE;
+    }
+
+    for( int i = 0; i != NUM_BLOCKS / 2; ++i )
+    {
+        PFREE( ptrs[i] );
+    }
+
+    for( int i = 0; i != NUM_LARGE; ++i )
+    {
+        PFREE( large_ptrs[i] );
+    }
+
+    s = PSTATS();
+
+    if( s.classes[1].frees != NUM_BLOCKS / 2 || s.classes[1].live != NUM_BLOCKS / 2 )
+    {
+        return EXIT_FAILURE;
+    }
+
+    if( s.large_frees != NUM_LARGE || s.large_live != 0 || s.large_bytes != 0 )
+    {
+        return EXIT_FAILURE;
+    }
+
+    if( s.allocs != NUM_BLOCKS + NUM_LARGE || s.frees != NUM_BLOCKS / 2 + NUM_LARGE )
+    {
+        return EXIT_FAILURE;
+    }
+
+#if defined(PALLOC_THREAD)
+    if( test_threads() == 0 )
+    {
+        return EXIT_FAILURE;
+    }
+
+    s = PSTATS();
+#endif
+
+    size_t text_nbytes = PSTATS_DUMP( &s, PSTATS_TEXT, NULL, 0 );
+    size_t json_nbytes = PSTATS_DUMP( &s, PSTATS_JSON, NULL, 0 );
+
+    char * text = (char *)malloc( text_nbytes + 1 );
+    char * json = (char *)malloc( json_nbytes + 1 );
+
+    if( PSTATS_DUMP( &s, PSTATS_TEXT, text, text_nbytes + 1 ) != text_nbytes || strlen( text ) != text_nbytes )
+    {
+        return EXIT_FAILURE;
+    }
+
+    if( PSTATS_DUMP( &s, PSTATS_JSON, json, json_nbytes + 1 ) != json_nbytes || json[0] != '{' || json[json_nbytes - 1] != '}' )
+    {
+        return EXIT_FAILURE;
+    }
+
+    printf( "%s\n%s\n", text, json );
+
+    free( text );
+    free( json );
+
+    PFINI();
+
+    s = PSTATS();
+
+    if( s.allocs != 0 || s.classes[1].chunks != 0 )
+    {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
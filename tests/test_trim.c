@@ -0,0 +1,89 @@
+#include "palloc/palloc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_BLOCKS 100000
+
+static void * ptrs[NUM_BLOCKS];
+
+static size_t test_fill( size_t nbytes )
+{
+    for( int i = 0; i != NUM_BLOCKS; ++i )
+    {
+        ptrs[i] = PALLOC( nbytes );
+
+        if( ptrs[i] == NULL )
+        {
+            return 0;
+        }
+
+        memset( ptrs[i], i & 0xff, nbytes );
+    }
+
+    return (size_t)NUM_BLOCKS * nbytes;
+}
+
+int main( void )
+{
+    PINIT();
+
+    size_t nbytes = test_fill( 64 );
+
+    if( nbytes == 0 )
+    {
+        return EXIT_FAILURE;
+    }
+
+    // keep the first block so its chunk survives the trim
+    for( int i = 1; i != NUM_BLOCKS; ++i )
+    {
+        PFREE( ptrs[i] );
+    }
+
+    size_t released = PTRIM();
+
+    printf( "peak: %zu bytes, released: %zu bytes\n", nbytes, released );
+
+    if( released < nbytes / 2 )
+    {
+        return EXIT_FAILURE;
+    }
+
+    unsigned char * p = (unsigned char *)ptrs[0];
+
+    for( size_t i = 0; i != 64; ++i )
+    {
+        if( p[i] != 0 )
+        {
+            return EXIT_FAILURE;
+        }
+    }
+
+    PFREE( p );
+
+    released = PTRIM();
+
+    printf( "last chunk released: %zu bytes\n", released );
+
+    if( released == 0 )
+    {
+        return EXIT_FAILURE;
+    }
+
+    if( PTRIM() != 0 )
+    {
+        return EXIT_FAILURE;
+    }
+
+    // allocation after a trim refills from new chunks; PFINI releases them
+    if( test_fill( 200 ) == 0 )
+    {
+        return EXIT_FAILURE;
+    }
+
+    PFINI();
+
+    return EXIT_SUCCESS;
+}